@@ -27,11 +27,13 @@
 #include "prompt.h"
 #include "ltag.h"
 #include "lscolors.h"
+#include "jobs.h"
 
 //static void exe_cmdline(char *str, bool aliases_are_expanded);
 
 void exit_yafc(void)
 {
+	job_kill_all();
 	ftp_quit_all();
 	list_free(gvFtpList);
   gvFtpList = NULL;
@@ -88,6 +90,7 @@ void command_loop(void)
 		char *cmdstr, *s;
 
 		ftp_initsigs();
+		job_check();
 
 #if 0 && (defined(HAVE_SETPROCTITLE) || defined(linux))
 		if(gvUseEnvString) {
@@ -152,6 +155,7 @@ static void exe_cmd(cmd_t *c, args_t *args)
 {
 	int i;
 	char *e;
+	bool bg;
 
 	if(!ftp_connected() && c->needconnect)
 		fprintf(stderr,
@@ -160,6 +164,8 @@ static void exe_cmd(cmd_t *c, args_t *args)
 		fprintf(stderr,
 				_("Not logged in. Try 'user --help' for more information.\n"));
 	else {
+		bg = job_strip_background(c->func, args);
+
 		for(i=1; i<args->argc; i++) {
 			int ret;
 			switch(args->argv[i][0]) {
@@ -194,7 +200,10 @@ static void exe_cmd(cmd_t *c, args_t *args)
 		}
 
 		gvInterrupted = false;
-		c->func(args->argc, args->argv);
+		if(bg)
+			job_start(c->func, args->argc, args->argv);
+		else
+			c->func(args->argc, args->argv);
 		gvInterrupted = false;
 		gvInTransfer = false;
 		close_redirection();
@@ -52,11 +52,13 @@ cmd_t cmds[] = {
 	CMD(nlist, 0,0,1, cpRemoteFile),
 	CMD(nop, 0,0,1, cpNone),
 	CMD(idle, 0,0,1, cpNone),
+	CMD(jobs, 0,0,1, cpNone),
 	CMD(open, 0,0,1, cpHostname),
 	CMD(put, 0,0,0, cpLocalFile),
 	CMD(pwd, 0,0,1, cpNone),
 	CMD(quit, 0,0,1, cpNone),
 	CMD(exit, 0,0,1, cpNone),
+	CMD(fg, 0,0,1, cpNone),
 	CMD(quote, 0,0,1, cpNone),
 	CMD(mv, 0,0,1, cpRemoteFile),
 	CMD(reopen, 1,1,1, cpNone),
@@ -77,6 +79,7 @@ cmd_t cmds[] = {
 	CMD(url, 0,0,1, cpNone),
 	CMD(user, 0,0,1, cpNone),
 	CMD(version, 0,0,1, cpNone),
+	CMD(wait, 0,0,1, cpNone),
 	CMD(warranty, 0,0,1, cpNone),
 #ifdef HAVE_KERBEROS
 	CMD(prot, 1,1,1, cpNone),
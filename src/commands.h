@@ -127,6 +127,11 @@ DEFCMD(put);
 /* fxp.c */
 DEFCMD(fxp);
 
+/* jobs.c */
+DEFCMD(jobs);
+DEFCMD(fg);
+DEFCMD(wait);
+
 /* ls.c */
 DEFCMD(ls);
 DEFCMD(nlist);
@@ -16,20 +16,375 @@
 #include "xmalloc.h"
 #include "strq.h"
 #include "gvars.h"
+#include "cachefile.h"
+
+#define CACHE_MIN_BUCKETS 64
+
+/* a cached directory, in a hash bucket and in the LRU list */
+typedef struct cache_entry
+{
+	rdirectory *rdir;
+	unsigned int hash;
+	size_t size;                      /* memory used by rdir */
+	struct cache_entry *hnext;        /* next in the same bucket */
+	struct cache_entry *prev, *next;  /* LRU list, most recent first */
+} cache_entry;
+
+struct dircache
+{
+	cache_entry **buckets;
+	unsigned int nbuckets;
+	unsigned int count;
+	cache_entry *mru, *lru;
+	list *retired;   /* replaced directories, freed at the next flush */
+	cachefile *file; /* persistent cache, opened at the first miss */
+	bool file_opened;
+	list *forgotten; /* paths flushed since the persistent cache was read */
+	size_t memory;
+	unsigned long hits, misses, evictions;
+};
+
+static unsigned int cache_hash(const char *path)
+{
+	unsigned int h = 2166136261U;   /* FNV-1a */
+
+	while(*path) {
+		h ^= (unsigned char)*path++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+dircache *ftp_cache_create(void)
+{
+	dircache *cache = xmalloc(sizeof(dircache));
+
+	cache->nbuckets = CACHE_MIN_BUCKETS;
+	cache->buckets = xmalloc(cache->nbuckets * sizeof(cache_entry *));
+	cache->retired = list_new((listfunc)rdir_destroy);
+	cache->forgotten = list_new((listfunc)free);
+	return cache;
+}
+
+static void cache_lru_unlink(dircache *cache, cache_entry *ce)
+{
+	if(ce->prev)
+		ce->prev->next = ce->next;
+	else
+		cache->mru = ce->next;
+	if(ce->next)
+		ce->next->prev = ce->prev;
+	else
+		cache->lru = ce->prev;
+	ce->prev = ce->next = 0;
+}
+
+static void cache_lru_push(dircache *cache, cache_entry *ce)
+{
+	ce->prev = 0;
+	ce->next = cache->mru;
+	if(cache->mru)
+		cache->mru->prev = ce;
+	cache->mru = ce;
+	if(!cache->lru)
+		cache->lru = ce;
+}
+
+static cache_entry *cache_find(dircache *cache, const char *path)
+{
+	unsigned int h = cache_hash(path);
+	cache_entry *ce;
+
+	for(ce = cache->buckets[h % cache->nbuckets]; ce; ce = ce->hnext) {
+		if(ce->hash == h && strcmp(ce->rdir->path, path) == 0)
+			return ce;
+	}
+	return 0;
+}
+
+/* removes CE from CACHE, the directory is destroyed, or kept until
+ * the next flush if RETIRE is true since it might still be in use
+ */
+static void cache_remove(dircache *cache, cache_entry *ce, bool retire)
+{
+	cache_entry **pp = &cache->buckets[ce->hash % cache->nbuckets];
+
+	while(*pp != ce)
+		pp = &(*pp)->hnext;
+	*pp = ce->hnext;
+	cache_lru_unlink(cache, ce);
+	cache->count--;
+	cache->memory -= ce->size;
+
+	if(retire)
+		list_additem(cache->retired, ce->rdir);
+	else
+		rdir_destroy(ce->rdir);
+	free(ce);
+}
+
+static void cache_grow(dircache *cache)
+{
+	unsigned int n = cache->nbuckets * 2;
+	cache_entry **buckets = xmalloc(n * sizeof(cache_entry *));
+	unsigned int i;
+
+	for(i = 0; i < cache->nbuckets; i++) {
+		cache_entry *ce, *next;
+		for(ce = cache->buckets[i]; ce; ce = next) {
+			next = ce->hnext;
+			ce->hnext = buckets[ce->hash % n];
+			buckets[ce->hash % n] = ce;
+		}
+	}
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->nbuckets = n;
+}
+
+/* evicts the least recently used directories until the cache fits in
+ * gvCacheMaxMemory, the most recently used one is always kept
+ */
+static void cache_evict(dircache *cache)
+{
+	while(gvCacheMaxMemory && cache->memory > gvCacheMaxMemory
+		  && cache->lru != cache->mru)
+	{
+		ftp_trace("evicted directory '%s' from cache\n",
+				  cache->lru->rdir->path);
+		cache->evictions++;
+		cache_remove(cache, cache->lru, false);
+	}
+}
+
+void ftp_cache_destroy(dircache *cache)
+{
+	if(!cache)
+		return;
+	while(cache->mru)
+		cache_remove(cache, cache->mru, false);
+	list_free(cache->retired);
+	list_free(cache->forgotten);
+	cachefile_close(cache->file);
+	free(cache->buckets);
+	free(cache);
+}
+
+/* adds RDIR to the cache of the current connection, replacing any
+ * directory with the same path
+ */
+void ftp_cache_add(rdirectory *rdir)
+{
+	dircache *cache = ftp->cache;
+	cache_entry *ce;
+
+	ce = cache_find(cache, rdir->path);
+	if(ce)
+		cache_remove(cache, ce, true);
+
+	if(cache->count >= cache->nbuckets)
+		cache_grow(cache);
+
+	ce = xmalloc(sizeof(cache_entry));
+	ce->rdir = rdir;
+	ce->hash = cache_hash(rdir->path);
+	ce->size = rdir_memsize(rdir);
+	ce->hnext = cache->buckets[ce->hash % cache->nbuckets];
+	cache->buckets[ce->hash % cache->nbuckets] = ce;
+	cache_lru_push(cache, ce);
+	cache->count++;
+	cache->memory += ce->size;
+
+	ftp_trace("added directory '%s' to cache\n", rdir->path);
+}
+
+/* returns true if the cache of the current connection uses all the
+ * memory it is allowed to
+ */
+bool ftp_cache_full(void)
+{
+	return gvCacheMaxMemory && ftp->cache->memory >= gvCacheMaxMemory;
+}
+
+/* returns the name of the persistent cache file of the current
+ * connection, or 0 if the persistent cache is disabled
+ */
+static char *cache_filename(void)
+{
+	char *filename, *e;
+	const char *user;
+
+	if(!gvPersistentCacheTTL || !gvWorkingDirectory || !ftp->url
+	   || !ftp->url->hostname)
+		return 0;
+
+	user = ftp->url->username ? ftp->url->username : "anonymous";
+	if(asprintf(&filename, "%s/cache/%s@%s:%d", gvWorkingDirectory,
+				user, ftp->url->hostname, ftp->url->port) == -1)
+		return 0;
+	for(e = filename + strlen(gvWorkingDirectory) + 7; *e; e++) {
+		if(*e == '/')
+			*e = '_';
+	}
+	return filename;
+}
+
+/* PATH has been changed or removed, don't use or keep the copy in the
+ * persistent cache
+ */
+static void cache_forget(dircache *cache, const char *path)
+{
+	if(!gvPersistentCacheTTL)
+		return;
+	cachefile_forget(cache->file, path);
+	if(list_search(cache->forgotten, (listsearchfunc)strcmp, path) == 0)
+		list_additem(cache->forgotten, xstrdup(path));
+}
+
+/* checks if RDIR, read from the persistent cache, is still usable
+ *
+ * it must not be older than the persistent_cache_ttl, and if its
+ * parent directory is cached, it must still be there. Only if an MLSD
+ * listing of this session gave the exact modification time of the
+ * directory, it must also not have been modified since RDIR was listed;
+ * the time in a LIST line is too coarse and in the server's time zone
+ */
+static bool cache_file_valid(dircache *cache, rdirectory *rdir)
+{
+	time_t now = time(0);
+	cache_entry *ce;
+	char *parent;
+	rfile *f;
+
+	if(rdir->timestamp + gvPersistentCacheTTL <= now
+	   || (gvCacheTimeout && rdir->timestamp + gvCacheTimeout <= now))
+		return false;
+
+	if(strcmp(rdir->path, "/") == 0)
+		return true;
+	parent = base_dir_xptr(rdir->path);
+	ce = parent ? cache_find(cache, parent) : 0;
+	free(parent);
+	if(!ce)
+		return true;
+
+	f = rdir_get_file(ce->rdir, base_name_ptr(rdir->path));
+	if(!f)
+		return false;
+	return !(f->exact & RFILE_EXACT_MTIME) || f->mtime <= rdir->timestamp;
+}
+
+/* PATH is absolute and NOT quoted */
+/* reads the directory PATH from the persistent cache and adds it to the
+ * cache, returns 0 if not found or outdated
+ */
+rdirectory *ftp_cache_load_directory(const char *path)
+{
+	dircache *cache = ftp->cache;
+	rdirectory *rdir;
+
+	if(!gvPersistentCacheTTL)
+		return 0;
+
+	if(!cache->file_opened) {
+		char *filename = cache_filename();
+		listitem *li;
+		if(filename) {
+			cache->file = cachefile_open(filename);
+			free(filename);
+		}
+		for(li = cache->forgotten->first; li; li = li->next)
+			cachefile_forget(cache->file, (char *)li->data);
+		cache->file_opened = true;
+	}
+
+	rdir = cachefile_get(cache->file, path);
+	if(!rdir)
+		return 0;
+
+	if(!cache_file_valid(cache, rdir)) {
+		ftp_trace("persistent cache of directory '%s' is outdated\n", path);
+		cache_forget(cache, path);
+		rdir_destroy(rdir);
+		return 0;
+	}
+
+	ftp_trace("loaded directory '%s' from persistent cache\n", path);
+	ftp_cache_add(rdir);
+	return rdir;
+}
+
+/* saves the cached directories of the current connection to its
+ * persistent cache file, merged with what other sessions have saved
+ * there in the meantime
+ */
+void ftp_cache_save(void)
+{
+	dircache *cache = ftp->cache;
+	char *filename, *dir;
+	cache_entry *ce;
+	cachefile *cf;
+	listitem *li;
+	list *dirs;
+
+	if(!cache->count && !list_numitem(cache->forgotten)
+	   && !list_numitem(ftp->dirs_to_flush))
+		return;
+	filename = cache_filename();
+	if(!filename)
+		return;
+
+	if(asprintf(&dir, "%s/cache", gvWorkingDirectory) != -1) {
+		mkdir(dir, S_IRUSR|S_IWUSR|S_IXUSR);
+		free(dir);
+	}
+
+	/* re-read the file, it may have been saved by another session */
+	cachefile_close(cache->file);
+	cache->file = 0;
+	cache->file_opened = false;
+	cf = cachefile_open(filename);
+
+	for(li = cache->forgotten->first; li; li = li->next)
+		cachefile_forget(cf, (char *)li->data);
+	list_clear(cache->forgotten);
+
+	dirs = list_new(0);
+	for(li = ftp->dirs_to_flush->first; li; li = li->next)
+		cachefile_forget(cf, (char *)li->data);
+	for(ce = cache->mru; ce; ce = ce->next) {
+		if(list_search(ftp->dirs_to_flush, (listsearchfunc)strcmp,
+					   ce->rdir->path) == 0)
+			list_additem(dirs, ce->rdir);
+	}
+
+	if(cachefile_save(cf, filename, dirs,
+					  time(0) - gvPersistentCacheTTL + 1) != 0)
+		ftp_err(_("Unable to save directory cache to %s: %s\n"),
+				filename, strerror(errno));
+	else
+		ftp_trace("saved directory cache to %s\n", filename);
+
+	list_free(dirs);
+	cachefile_close(cf);
+	free(filename);
+}
 
 void ftp_cache_list_contents(void)
 {
-	listitem *li = ftp->cache->first;
+	dircache *cache = ftp->cache;
+	cache_entry *ce;
 
 	ftp_cache_flush();
 
-	printf("Directory cache contents: (%u items)\n",
-		   list_numitem(ftp->cache));
+	printf("Directory cache contents: (%u items, %lu bytes)\n",
+		   cache->count, (unsigned long)cache->memory);
 
-	while(li) {
-		printf("%s\n", ((rdirectory *)li->data)->path);
-		li = li->next;
-	}
+	for(ce = cache->lru; ce; ce = ce->prev)
+		printf("%s\n", ce->rdir->path);
+
+	printf(_("%lu hits, %lu misses, %lu evictions\n"),
+		   cache->hits, cache->misses, cache->evictions);
 }
 
 /* marks the directory PATH to be flushed in the
@@ -62,24 +417,24 @@ void ftp_cache_flush_mark_for(const char *path)
 	free(e);
 }
 
-static int cache_search(rdirectory *rdir, const char *arg)
-{
-	return strcmp(rdir->path, arg);
-}
-
-/* flushes directories marked by ftp_cache_flush_mark*()
+/* flushes directories marked by ftp_cache_flush_mark*(), and evicts
+ * directories if the cache uses more memory than allowed
+ *
+ * this is only done between commands, when no rdirectory
+ * returned from the cache is in use anymore
  */
 void ftp_cache_flush(void)
 {
-	listitem *e;
+	dircache *cache = ftp->cache;
 	listitem *li = ftp->dirs_to_flush->first;
 
 	while(li) {
 		char *dir = (char *)li->data;
-		e = list_search(ftp->cache, (listsearchfunc)cache_search, dir);
-		if(e) {
+		cache_entry *ce = cache_find(cache, dir);
+		cache_forget(cache, dir);
+		if(ce) {
 			ftp_trace("flushed directory '%s'\n", dir);
-			list_delitem(ftp->cache, e);
+			cache_remove(cache, ce, false);
 		} else
 			ftp_trace("error flushing directory '%s' (not cached)\n", dir);
 
@@ -87,13 +442,29 @@ void ftp_cache_flush(void)
 	}
 
 	list_clear(ftp->dirs_to_flush);
+	list_clear(cache->retired);
+	cache_evict(cache);
 }
 
 void ftp_cache_clear(void)
 {
+	dircache *cache = ftp->cache;
+	char *filename;
+
 	list_clear(ftp->dirs_to_flush);
-	list_clear(ftp->cache);
+	while(cache->mru)
+		cache_remove(cache, cache->mru, false);
+	list_clear(cache->retired);
 	ftp_trace("clear whole directory cache\n");
+
+	cachefile_close(cache->file);
+	cache->file = 0;
+	cache->file_opened = true;
+	list_clear(cache->forgotten);
+	filename = cache_filename();
+	if(filename && unlink(filename) == 0)
+		ftp_trace("removed persistent cache %s\n", filename);
+	free(filename);
 }
 
 /* PATH is NOT quoted */
@@ -101,7 +472,8 @@ void ftp_cache_clear(void)
  */
 rdirectory *ftp_cache_get_directory(const char *path)
 {
-	listitem *li;
+	dircache *cache = ftp->cache;
+	cache_entry *ce;
 	char *dir_to_search_for;
 
 	if(path)
@@ -109,11 +481,10 @@ rdirectory *ftp_cache_get_directory(const char *path)
 	else
 		dir_to_search_for = xstrdup(ftp->curdir);
 
-	li = list_search(ftp->cache, (listsearchfunc)cache_search,
-					 dir_to_search_for);
+	ce = cache_find(cache, dir_to_search_for);
 
-	if(li && gvCacheTimeout &&
-	   ((rdirectory *)li->data)->timestamp + gvCacheTimeout <= time(0))
+	if(ce && gvCacheTimeout &&
+	   ce->rdir->timestamp + gvCacheTimeout <= time(0))
 	{
 		/* directory cache has timed out */
 
@@ -123,10 +494,15 @@ rdirectory *ftp_cache_get_directory(const char *path)
 	}
 	free(dir_to_search_for);
 
-	if(!li)
+	if(!ce) {
+		cache->misses++;
 		return 0;
+	}
 
-	return (rdirectory *)li->data;
+	cache->hits++;
+	cache_lru_unlink(cache, ce);
+	cache_lru_push(cache, ce);
+	return ce->rdir;
 }
 
 /* returns a file from the cache, or 0 if not found
@@ -0,0 +1,490 @@
+/*
+ * cachefile.c -- persistent directory cache file
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+/* The file starts with CACHEFILE_MAGIC, followed by one record per
+ * directory:
+ *
+ *   uint32 length of the rest of the record
+ *   int64  time the directory was listed
+ *   uint32 number of files
+ *   string path of the directory
+ *
+ * and for each file:
+ *
+ *   int64  mtime
+ *   uint64 size
+ *   uint32 number of hard links
+ *   string perm, owner, group, date, link, path
+ *
+ * Strings are stored as a uint32 length, including the terminating
+ * nul, followed by the characters; a length of 0 means a null pointer.
+ * Numbers are stored in host byte order, the file is not meant to be
+ * moved between machines.
+ *
+ * The RFILE_EXACT_* flags are not stored, what a server said in an
+ * earlier session may be out of date, so only listings and replies of
+ * this session are trusted over a new MDTM or SIZE.
+ */
+
+#include "syshdr.h"
+
+#include "cachefile.h"
+#include "rfile.h"
+#include "xmalloc.h"
+
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#define CACHEFILE_MAGIC "YAFCDC1\n"
+#define CACHEFILE_MAGICLEN 8
+
+typedef struct cf_record
+{
+	const char *path;     /* points into the file data */
+	const char *start;    /* start of the record, including the length */
+	size_t len;
+	time_t stamp;
+	bool forgotten;       /* outdated, not loaded nor saved again */
+} cf_record;
+
+struct cachefile
+{
+	char *data;
+	size_t size;
+	bool mapped;
+	cf_record *records;   /* sorted by path */
+	unsigned int nrecords;
+};
+
+typedef struct cf_reader
+{
+	const char *p, *end;
+	bool error;
+} cf_reader;
+
+typedef struct cf_buffer
+{
+	char *data;
+	size_t len, size;
+} cf_buffer;
+
+static void cf_read(cf_reader *r, void *dst, size_t n)
+{
+	if(r->error || (size_t)(r->end - r->p) < n) {
+		r->error = true;
+		memset(dst, 0, n);
+		return;
+	}
+	memcpy(dst, r->p, n);
+	r->p += n;
+}
+
+/* returns a pointer to the string in the file data, or 0 */
+static const char *cf_read_strptr(cf_reader *r)
+{
+	const char *s;
+	uint32_t len;
+
+	cf_read(r, &len, sizeof(len));
+	if(r->error || len == 0)
+		return 0;
+	if((size_t)(r->end - r->p) < len || r->p[len - 1] != 0) {
+		r->error = true;
+		return 0;
+	}
+	s = r->p;
+	r->p += len;
+	return s;
+}
+
+static int cf_record_cmp(const void *a, const void *b)
+{
+	return strcmp(((const cf_record *)a)->path, ((const cf_record *)b)->path);
+}
+
+static cf_record *cf_find(cachefile *cf, const char *path)
+{
+	cf_record key;
+
+	if(!cf || !cf->nrecords)
+		return 0;
+	key.path = path;
+	return bsearch(&key, cf->records, cf->nrecords, sizeof(cf_record),
+				   cf_record_cmp);
+}
+
+static bool cf_load_data(cachefile *cf, int fd)
+{
+	struct stat sb;
+
+	if(fstat(fd, &sb) != 0 || sb.st_size < CACHEFILE_MAGICLEN)
+		return false;
+	cf->size = sb.st_size;
+
+#ifdef HAVE_SYS_MMAN_H
+	cf->data = mmap(0, cf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(cf->data != MAP_FAILED) {
+		cf->mapped = true;
+		return true;
+	}
+#endif
+	cf->data = xmalloc(cf->size);
+	if(read(fd, cf->data, cf->size) != (ssize_t)cf->size) {
+		free(cf->data);
+		cf->data = 0;
+		return false;
+	}
+	return true;
+}
+
+/* opens the cache file FILENAME and indexes its directories, the
+ * directories themselves are only read by cachefile_get()
+ *
+ * returns 0 if the file doesn't exist or isn't a cache file
+ */
+cachefile *cachefile_open(const char *filename)
+{
+	cachefile *cf;
+	const char *p, *end;
+	unsigned int size = 0;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if(fd == -1)
+		return 0;
+
+	cf = xmalloc(sizeof(cachefile));
+	if(!cf_load_data(cf, fd)
+	   || memcmp(cf->data, CACHEFILE_MAGIC, CACHEFILE_MAGICLEN) != 0)
+	{
+		close(fd);
+		cachefile_close(cf);
+		return 0;
+	}
+	close(fd);
+
+	p = cf->data + CACHEFILE_MAGICLEN;
+	end = cf->data + cf->size;
+	while((size_t)(end - p) >= sizeof(uint32_t)) {
+		cf_reader r;
+		cf_record *rec;
+		int64_t stamp;
+		uint32_t len, nfiles;
+		const char *path;
+
+		memcpy(&len, p, sizeof(len));
+		if(len > (size_t)(end - p) - sizeof(len))
+			break;  /* truncated */
+
+		r.p = p + sizeof(len);
+		r.end = r.p + len;
+		r.error = false;
+		cf_read(&r, &stamp, sizeof(stamp));
+		cf_read(&r, &nfiles, sizeof(nfiles));
+		path = cf_read_strptr(&r);
+
+		if(!r.error && path) {
+			if(cf->nrecords == size) {
+				size = size ? size * 2 : 64;
+				cf->records = xrealloc(cf->records, size * sizeof(cf_record));
+			}
+			rec = &cf->records[cf->nrecords++];
+			rec->path = path;
+			rec->start = p;
+			rec->len = sizeof(len) + len;
+			rec->stamp = (time_t)stamp;
+			rec->forgotten = false;
+		}
+		p += sizeof(len) + len;
+	}
+
+	qsort(cf->records, cf->nrecords, sizeof(cf_record), cf_record_cmp);
+	return cf;
+}
+
+void cachefile_close(cachefile *cf)
+{
+	if(!cf)
+		return;
+	if(cf->data) {
+#ifdef HAVE_SYS_MMAN_H
+		if(cf->mapped)
+			munmap(cf->data, cf->size);
+		else
+#endif
+			free(cf->data);
+	}
+	free(cf->records);
+	free(cf);
+}
+
+/* returns the directory in the record DATA, LEN bytes long and not
+ * including the length of the record, or 0 if the record is corrupt
+ */
+static rdirectory *cf_parse_directory(const char *data, size_t len)
+{
+	rdirectory *rdir;
+	cf_reader r;
+	int64_t stamp;
+	uint32_t nfiles, i;
+	const char *path;
+
+	r.p = data;
+	r.end = data + len;
+	r.error = false;
+	cf_read(&r, &stamp, sizeof(stamp));
+	cf_read(&r, &nfiles, sizeof(nfiles));
+	path = cf_read_strptr(&r);
+	if(r.error || !path)
+		return 0;
+
+	rdir = rdir_create();
+	rdir->path = xstrdup(path);
+	rdir->timestamp = (time_t)stamp;
+
+	for(i = 0; i < nfiles && !r.error; i++) {
+		rfile f;
+		int64_t mtime;
+		uint64_t size;
+		uint32_t nhl;
+
+		/* the strings point into the file data until copied by
+		 * rdir_add_file() */
+		cf_read(&r, &mtime, sizeof(mtime));
+		cf_read(&r, &size, sizeof(size));
+		cf_read(&r, &nhl, sizeof(nhl));
+		f.mtime = (time_t)mtime;
+		f.size = size;
+		f.nhl = nhl;
+		f.exact = 0;
+		f.perm = (char *)cf_read_strptr(&r);
+		f.owner = (char *)cf_read_strptr(&r);
+		f.group = (char *)cf_read_strptr(&r);
+		f.date = (char *)cf_read_strptr(&r);
+		f.link = (char *)cf_read_strptr(&r);
+		f.path = (char *)cf_read_strptr(&r);
+		f.color = 0;
+		if(r.error || !f.path || !f.perm) {
+			r.error = true;
+			break;
+		}
+		rdir_add_file(rdir, &f);
+	}
+
+	if(r.error) {
+		rdir_destroy(rdir);
+		return 0;
+	}
+
+	rdir_sort(rdir);
+	return rdir;
+}
+
+/* returns the directory PATH read from the cache file, with the time
+ * it was listed as timestamp, or 0 if not found
+ */
+rdirectory *cachefile_get(cachefile *cf, const char *path)
+{
+	cf_record *rec = cf_find(cf, path);
+	rdirectory *rdir;
+
+	if(!rec || rec->forgotten)
+		return 0;
+
+	rdir = cf_parse_directory(rec->start + sizeof(uint32_t),
+							  rec->len - sizeof(uint32_t));
+	if(!rdir)
+		rec->forgotten = true;
+	return rdir;
+}
+
+/* marks the directory PATH as outdated, it won't be returned by
+ * cachefile_get() nor kept by cachefile_save()
+ */
+void cachefile_forget(cachefile *cf, const char *path)
+{
+	cf_record *rec = cf_find(cf, path);
+
+	if(rec)
+		rec->forgotten = true;
+}
+
+static void cf_put(cf_buffer *b, const void *src, size_t n)
+{
+	if(b->len + n > b->size) {
+		b->size = (b->len + n) * 2;
+		b->data = xrealloc(b->data, b->size);
+	}
+	memcpy(b->data + b->len, src, n);
+	b->len += n;
+}
+
+static void cf_put_str(cf_buffer *b, const char *s)
+{
+	uint32_t len = s ? strlen(s) + 1 : 0;
+
+	cf_put(b, &len, sizeof(len));
+	if(len)
+		cf_put(b, s, len);
+}
+
+static void cf_write_directory(FILE *fp, cf_buffer *b, rdirectory *rdir)
+{
+	int64_t stamp = rdir->timestamp;
+	uint32_t nfiles = list_numitem(rdir->files);
+	uint32_t len;
+	listitem *li;
+
+	b->len = 0;
+	cf_put(b, &stamp, sizeof(stamp));
+	cf_put(b, &nfiles, sizeof(nfiles));
+	cf_put_str(b, rdir->path);
+
+	for(li = rdir->files->first; li; li = li->next) {
+		rfile *f = (rfile *)li->data;
+		int64_t mtime = f->mtime;
+		uint64_t size = f->size;
+		uint32_t nhl = f->nhl;
+
+		cf_put(b, &mtime, sizeof(mtime));
+		cf_put(b, &size, sizeof(size));
+		cf_put(b, &nhl, sizeof(nhl));
+		cf_put_str(b, f->perm);
+		cf_put_str(b, f->owner);
+		cf_put_str(b, f->group);
+		cf_put_str(b, f->date);
+		cf_put_str(b, f->link);
+		cf_put_str(b, f->path);
+	}
+
+	len = b->len;
+	fwrite(&len, sizeof(len), 1, fp);
+	fwrite(b->data, b->len, 1, fp);
+}
+
+/* writes RDIR to FP as a single cache file record, or an empty record
+ * if RDIR is 0; used to pass directories between processes
+ */
+void cachefile_write_directory(FILE *fp, rdirectory *rdir)
+{
+	cf_buffer buf = {0, 0, 0};
+	uint32_t len = 0;
+
+	if(rdir)
+		cf_write_directory(fp, &buf, rdir);
+	else
+		fwrite(&len, sizeof(len), 1, fp);
+	free(buf.data);
+}
+
+/* reads a record written by cachefile_write_directory() from the file
+ * descriptor FD, blocking until all of it has arrived
+ *
+ * returns 0 on success, with *RDIR set to the directory or to 0 for an
+ * empty record, or -1 on end of file or error
+ */
+int cachefile_read_directory(int fd, rdirectory **rdir)
+{
+	uint32_t len;
+	char *data;
+	size_t n = 0;
+
+	*rdir = 0;
+	while(n < sizeof(len)) {
+		ssize_t r = read(fd, (char *)&len + n, sizeof(len) - n);
+		if(r <= 0) {
+			if(r == -1 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		n += r;
+	}
+	if(len == 0)
+		return 0;
+
+	data = xmalloc(len);
+	for(n = 0; n < len; ) {
+		ssize_t r = read(fd, data + n, len - n);
+		if(r <= 0) {
+			if(r == -1 && errno == EINTR)
+				continue;
+			free(data);
+			return -1;
+		}
+		n += r;
+	}
+	*rdir = cf_parse_directory(data, len);
+	free(data);
+	return 0;
+}
+
+/* writes the directories in DIRS, and the directories from CF not
+ * forgotten and not in DIRS, to FILENAME; directories listed before
+ * OLDEST are dropped
+ *
+ * the file is written to a temporary file first and then renamed, so
+ * other yafc processes see either the old or the new file
+ *
+ * returns 0 on success, -1 on error (with errno set)
+ */
+int cachefile_save(cachefile *cf, const char *filename, list *dirs,
+				   time_t oldest)
+{
+	cf_buffer buf = {0, 0, 0};
+	listitem *li;
+	unsigned int i;
+	char *tmp;
+	FILE *fp;
+	bool ok;
+
+	if(asprintf(&tmp, "%s.%u", filename, (unsigned)getpid()) == -1)
+		return -1;
+	fp = fopen(tmp, "w");
+	if(!fp) {
+		free(tmp);
+		return -1;
+	}
+	fchmod(fileno(fp), S_IRUSR|S_IWUSR);
+
+	fwrite(CACHEFILE_MAGIC, CACHEFILE_MAGICLEN, 1, fp);
+	for(li = dirs->first; li; li = li->next) {
+		rdirectory *rdir = (rdirectory *)li->data;
+		if(rdir->timestamp < oldest)
+			continue;
+		cf_write_directory(fp, &buf, rdir);
+		cachefile_forget(cf, rdir->path);
+	}
+	free(buf.data);
+
+	for(i = 0; cf && i < cf->nrecords; i++) {
+		cf_record *rec = &cf->records[i];
+		if(!rec->forgotten && rec->stamp >= oldest)
+			fwrite(rec->start, rec->len, 1, fp);
+	}
+
+	ok = !ferror(fp);
+	if(fclose(fp) != 0)
+		ok = false;
+	if(ok && rename(tmp, filename) != 0)
+		ok = false;
+	if(!ok) {
+		int e = errno;
+		unlink(tmp);
+		errno = e;
+	}
+	free(tmp);
+	return ok ? 0 : -1;
+}
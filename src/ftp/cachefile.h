@@ -0,0 +1,31 @@
+/*
+ * cachefile.h -- persistent directory cache file
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#ifndef _cachefile_h_included
+#define _cachefile_h_included
+
+#include "syshdr.h"
+#include "rdirectory.h"
+#include "linklist.h"
+
+typedef struct cachefile cachefile;
+
+cachefile *cachefile_open(const char *filename);
+void cachefile_close(cachefile *cf);
+rdirectory *cachefile_get(cachefile *cf, const char *path);
+void cachefile_forget(cachefile *cf, const char *path);
+int cachefile_save(cachefile *cf, const char *filename, list *dirs,
+				   time_t oldest);
+void cachefile_write_directory(FILE *fp, rdirectory *rdir);
+int cachefile_read_directory(int fd, rdirectory **rdir);
+
+#endif
@@ -0,0 +1,334 @@
+/*
+ * checksum.c -- incremental file checksums
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+/* CRC32 (as zlib and XCRC compute it), MD5 (RFC 1321) and SHA-256
+ * (FIPS 180-4), fed with the data as it is transferred
+ */
+
+#include "syshdr.h"
+
+#include "checksum.h"
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/* crc_table[k][b] is the CRC of byte B followed by K zero bytes, so
+ * eight bytes are folded in at a time (slicing-by-8)
+ */
+static uint32_t crc_table[8][256];
+
+static void crc_init_table(void)
+{
+	uint32_t c;
+	int i, k;
+
+	for(i = 0; i < 256; i++) {
+		c = i;
+		for(k = 0; k < 8; k++)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crc_table[0][i] = c;
+	}
+	for(i = 0; i < 256; i++) {
+		c = crc_table[0][i];
+		for(k = 1; k < 8; k++) {
+			c = crc_table[0][c & 0xff] ^ (c >> 8);
+			crc_table[k][i] = c;
+		}
+	}
+}
+
+static void crc_update(checksum *cs, const unsigned char *p, size_t n)
+{
+	uint32_t c = cs->state[0], hi;
+
+	for(; n >= 8; p += 8, n -= 8) {
+		c ^= p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+		hi = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+		c = crc_table[7][c & 0xff] ^ crc_table[6][(c >> 8) & 0xff]
+			^ crc_table[5][(c >> 16) & 0xff] ^ crc_table[4][c >> 24]
+			^ crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff]
+			^ crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+	}
+	while(n--)
+		c = crc_table[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+	cs->state[0] = c;
+}
+
+static const uint32_t md5_k[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+	0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+	0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+	0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+	0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+	0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+	0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+	0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int md5_r[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static void md5_block(uint32_t *h, const unsigned char *p)
+{
+	uint32_t w[16], a = h[0], b = h[1], c = h[2], d = h[3], f, t;
+	int i, g;
+
+	for(i = 0; i < 16; i++)
+		w[i] = p[4*i] | (p[4*i+1] << 8) | (p[4*i+2] << 16)
+			| ((uint32_t)p[4*i+3] << 24);
+
+	for(i = 0; i < 64; i++) {
+		if(i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if(i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5*i + 1) % 16;
+		} else if(i < 48) {
+			f = b ^ c ^ d;
+			g = (3*i + 5) % 16;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7*i) % 16;
+		}
+		t = d;
+		d = c;
+		c = b;
+		b += ROL(a + f + md5_k[i] + w[g], md5_r[i]);
+		a = t;
+	}
+
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+}
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define S256_ROUND(a, b, c, d, e, f, g, h, i) do { \
+		uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) \
+			+ ((e & f) ^ (~e & g)) + sha256_k[i] + w[i]; \
+		uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) \
+			+ ((a & b) ^ (a & c) ^ (b & c)); \
+		d += t1; \
+		h = t1 + t2; \
+	} while(0)
+
+static void sha256_block(uint32_t *h, const unsigned char *p)
+{
+	uint32_t w[64], s0, s1;
+	uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+	uint32_t e = h[4], f = h[5], g = h[6], hh = h[7];
+	int i;
+
+	for(i = 0; i < 16; i++)
+		w[i] = ((uint32_t)p[4*i] << 24) | (p[4*i+1] << 16)
+			| (p[4*i+2] << 8) | p[4*i+3];
+	for(; i < 64; i++) {
+		s0 = ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3);
+		s1 = ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10);
+		w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+
+	/* the variables rotate instead of being moved along */
+	for(i = 0; i < 64; i += 8) {
+		S256_ROUND(a, b, c, d, e, f, g, hh, i);
+		S256_ROUND(hh, a, b, c, d, e, f, g, i + 1);
+		S256_ROUND(g, hh, a, b, c, d, e, f, i + 2);
+		S256_ROUND(f, g, hh, a, b, c, d, e, i + 3);
+		S256_ROUND(e, f, g, hh, a, b, c, d, i + 4);
+		S256_ROUND(d, e, f, g, hh, a, b, c, i + 5);
+		S256_ROUND(c, d, e, f, g, hh, a, b, i + 6);
+		S256_ROUND(b, c, d, e, f, g, hh, a, i + 7);
+	}
+
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+	h[5] += f;
+	h[6] += g;
+	h[7] += hh;
+}
+
+/* feeds N bytes at P to the 64 byte block function of MD5 or SHA-256 */
+static void block_update(checksum *cs, const unsigned char *p, size_t n)
+{
+	void (*blockf)(uint32_t *, const unsigned char *);
+	size_t used = cs->length % 64;
+
+	blockf = (cs->type == csMD5) ? md5_block : sha256_block;
+	cs->length += n;
+
+	if(used > 0) {
+		size_t want = 64 - used;
+		if(n < want) {
+			memcpy(cs->block + used, p, n);
+			return;
+		}
+		memcpy(cs->block + used, p, want);
+		blockf(cs->state, cs->block);
+		p += want;
+		n -= want;
+	}
+	for(; n >= 64; p += 64, n -= 64)
+		blockf(cs->state, p);
+	memcpy(cs->block, p, n);
+}
+
+/* pads the last block with the bit length, little-endian for MD5 and
+ * big-endian for SHA-256
+ */
+static void block_final(checksum *cs)
+{
+	unsigned char pad[72];
+	uint64_t bits = cs->length * 8;
+	size_t npad = 64 - (cs->length + 8) % 64;
+	int i;
+
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for(i = 0; i < 8; i++) {
+		if(cs->type == csMD5)
+			pad[npad + i] = bits >> (8 * i);
+		else
+			pad[npad + i] = bits >> (56 - 8 * i);
+	}
+	block_update(cs, pad, npad + 8);
+}
+
+void checksum_init(checksum *cs, checksum_t type)
+{
+	static const uint32_t sha256_h[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memset(cs, 0, sizeof(checksum));
+	cs->type = type;
+	switch(type) {
+	  case csCRC32:
+		if(crc_table[0][1] == 0)
+			crc_init_table();
+		cs->state[0] = 0xffffffff;
+		break;
+	  case csMD5:
+		cs->state[0] = 0x67452301;
+		cs->state[1] = 0xefcdab89;
+		cs->state[2] = 0x98badcfe;
+		cs->state[3] = 0x10325476;
+		break;
+	  case csSHA256:
+		memcpy(cs->state, sha256_h, sizeof(sha256_h));
+		break;
+	  default:
+		break;
+	}
+}
+
+void checksum_update(checksum *cs, const void *data, size_t n)
+{
+	if(cs->type == csCRC32) {
+		crc_update(cs, (const unsigned char *)data, n);
+		cs->length += n;
+	} else if(cs->type != csNone)
+		block_update(cs, (const unsigned char *)data, n);
+}
+
+/* finishes the checksum and writes it to HEX in lowercase hex, HEX
+ * must hold CHECKSUM_HEXLEN + 1 characters
+ */
+void checksum_final(checksum *cs, char *hex)
+{
+	int i;
+
+	*hex = 0;
+	switch(cs->type) {
+	  case csCRC32:
+		sprintf(hex, "%08x", (unsigned)(cs->state[0] ^ 0xffffffff));
+		break;
+	  case csMD5:
+		block_final(cs);
+		for(i = 0; i < 16; i++)
+			sprintf(hex + 2*i, "%02x",
+					(unsigned)(cs->state[i / 4] >> (8 * (i % 4))) & 0xff);
+		break;
+	  case csSHA256:
+		block_final(cs);
+		for(i = 0; i < 8; i++)
+			sprintf(hex + 8*i, "%08x", (unsigned)cs->state[i]);
+		break;
+	  default:
+		break;
+	}
+}
+
+/* returns the name of TYPE as the HASH command (RFC draft
+ * draft-bryan-ftpext-hash) knows it
+ */
+const char *checksum_name(checksum_t type)
+{
+	switch(type) {
+	  case csCRC32:
+		return "CRC32";
+	  case csMD5:
+		return "MD5";
+	  case csSHA256:
+		return "SHA-256";
+	  default:
+		return "none";
+	}
+}
+
+/* returns the type named by the LEN characters at NAME, or csNone */
+checksum_t checksum_lookup(const char *name, size_t len)
+{
+	checksum_t type;
+
+	for(type = csCRC32; type <= csSHA256; type <<= 1) {
+		const char *s = checksum_name(type);
+		if(strlen(s) == len && strncasecmp(s, name, len) == 0)
+			return type;
+	}
+	return csNone;
+}
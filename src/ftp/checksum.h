@@ -0,0 +1,44 @@
+/*
+ * checksum.h -- incremental file checksums
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#ifndef _checksum_h_included
+#define _checksum_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* the types are bits, so a set of them fits in an unsigned int */
+typedef enum {
+	csNone = 0,
+	csCRC32 = 1,
+	csMD5 = 2,
+	csSHA256 = 4
+} checksum_t;
+
+/* length of the longest checksum in hex, without the terminating 0 */
+#define CHECKSUM_HEXLEN 64
+
+typedef struct checksum
+{
+	checksum_t type;
+	uint32_t state[8];
+	uint64_t length;         /* bytes hashed so far */
+	unsigned char block[64]; /* partial block of MD5 and SHA-256 */
+} checksum;
+
+void checksum_init(checksum *cs, checksum_t type);
+void checksum_update(checksum *cs, const void *data, size_t n);
+void checksum_final(checksum *cs, char *hex);
+const char *checksum_name(checksum_t type);
+checksum_t checksum_lookup(const char *name, size_t len);
+
+#endif
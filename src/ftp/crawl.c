@@ -0,0 +1,324 @@
+/*
+ * crawl.c -- list a directory tree over several connections
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+/* The crawler fills the directory cache with a whole directory tree
+ * before a recursive command walks it, so the command finds every
+ * directory in the cache instead of listing them one at a time.
+ *
+ * Each pooled connection is driven by a forked worker, connected to
+ * the parent by a socket pair. The parent keeps the queue of
+ * directories still to be listed and hands one path at a time to each
+ * idle worker, which lists it and sends the directory back as a cache
+ * file record. The subdirectories found are added to the queue.
+ */
+
+#include "syshdr.h"
+
+#include "ftp.h"
+#include "cachefile.h"
+#include "xmalloc.h"
+#include "gvars.h"
+
+#include <poll.h>
+
+typedef struct crawl_worker
+{
+	pid_t pid;
+	int fd;
+	bool busy;
+} crawl_worker;
+
+/* reads exactly LEN bytes from FD into BUF, the socket may return them
+ * in pieces; returns 0 on success, or -1 on end of file or error
+ */
+static int crawl_read(int fd, void *buf, size_t len)
+{
+	size_t n = 0;
+
+	while(n < len) {
+		ssize_t r = read(fd, (char *)buf + n, len - n);
+		if(r <= 0) {
+			if(r == -1 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		n += r;
+	}
+	return 0;
+}
+
+/* runs in a forked child: reads paths from FD, lists them over the
+ * pooled connection WFTP and writes the directories back to FD, until
+ * the parent closes its end
+ */
+static void crawl_worker_run(Ftp *wftp, int fd)
+{
+	FILE *fp = fdopen(fd, "w");
+	uint32_t len;
+	char *path;
+
+	ftp_use(wftp);
+	ftp_set_verbosity(vbNone);
+	/* the parent saves the persistent cache */
+	gvPersistentCacheTTL = 0;
+
+	while(fp && !gvInterrupted && crawl_read(fd, &len, sizeof(len)) == 0) {
+		rdirectory *rdir = 0;
+
+		path = xmalloc(len + 1);
+		if(crawl_read(fd, path, len) != 0) {
+			free(path);
+			break;
+		}
+		path[len] = 0;
+
+		if(ftp_connected())
+			rdir = ftp_read_directory(path);
+		cachefile_write_directory(fp, rdir);
+		fflush(fp);
+
+		/* the directory is in the parent's cache now */
+		if(rdir) {
+			ftp_cache_flush_mark(path);
+			ftp_cache_flush();
+		}
+		free(path);
+	}
+	_exit(0);
+}
+
+static int crawl_send(crawl_worker *w, const char *path)
+{
+	uint32_t len = strlen(path);
+	char *buf = xmalloc(sizeof(len) + len);
+	ssize_t r;
+
+	memcpy(buf, &len, sizeof(len));
+	memcpy(buf + sizeof(len), path, len);
+	r = write(w->fd, buf, sizeof(len) + len);
+	free(buf);
+	if(r != (ssize_t)(sizeof(len) + len))
+		return -1;
+	w->busy = true;
+	return 0;
+}
+
+static bool crawl_want(rfile *f, rglobfunc exclude)
+{
+	return risdir(f) && !risdotdir(f) && !(exclude && exclude(f));
+}
+
+static void crawl_visit(list *queue, const char *path, rglobfunc exclude);
+
+/* queues the subdirectories of RDIR */
+static void crawl_expand(list *queue, rdirectory *rdir, rglobfunc exclude)
+{
+	listitem *li;
+
+	for(li = rdir->files->first; li; li = li->next) {
+		rfile *f = (rfile *)li->data;
+		if(crawl_want(f, exclude))
+			crawl_visit(queue, f->path, exclude);
+	}
+}
+
+/* queues the directory PATH, unless it is already cached, in which case
+ * its subdirectories are visited instead
+ */
+static void crawl_visit(list *queue, const char *path, rglobfunc exclude)
+{
+	rdirectory *rdir;
+
+	rdir = ftp_cache_get_directory(path);
+	if(!rdir)
+		rdir = ftp_cache_load_directory(path);
+	if(rdir)
+		crawl_expand(queue, rdir, exclude);
+	else
+		list_additem(queue, xstrdup(path));
+}
+
+/* lists the directories in QUEUE over the pooled connections CONNS,
+ * one directory in flight per connection
+ */
+static void crawl_parallel(list *queue, list *conns, rglobfunc exclude)
+{
+	crawl_worker *workers;
+	struct pollfd *pfds;
+	unsigned int i, nworkers = 0, nbusy;
+	listitem *li;
+
+	workers = xmalloc(list_numitem(conns) * sizeof(crawl_worker));
+	pfds = xmalloc(list_numitem(conns) * sizeof(struct pollfd));
+
+	fflush(stdout);
+	fflush(stderr);
+	for(li = conns->first; li; li = li->next) {
+		int fds[2];
+		pid_t pid;
+
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+			perror("socketpair()");
+			break;
+		}
+		pid = fork();
+		if(pid == 0) {
+			for(i = 0; i < nworkers; i++)
+				close(workers[i].fd);
+			close(fds[0]);
+			crawl_worker_run((Ftp *)li->data, fds[1]);
+		}
+		close(fds[1]);
+		if(pid == -1) {
+			perror("fork()");
+			close(fds[0]);
+			break;
+		}
+		workers[nworkers].pid = pid;
+		workers[nworkers].fd = fds[0];
+		workers[nworkers].busy = false;
+		nworkers++;
+	}
+
+	while(!gvInterrupted) {
+		unsigned int npfds = 0;
+
+		nbusy = 0;
+		for(i = 0; i < nworkers; i++) {
+			crawl_worker *w = &workers[i];
+			if(w->fd != -1 && !w->busy && list_numitem(queue)
+			   && !ftp_cache_full())
+			{
+				if(crawl_send(w, (char *)queue->first->data) != 0) {
+					close(w->fd);
+					w->fd = -1;
+					continue;
+				}
+				list_delitem(queue, queue->first);
+			}
+			if(w->busy) {
+				pfds[npfds].fd = w->fd;
+				pfds[npfds].events = POLLIN;
+				npfds++;
+				nbusy++;
+			}
+		}
+		if(nbusy == 0)
+			break;
+
+		if(poll(pfds, npfds, -1) == -1) {
+			if(errno == EINTR)
+				continue;
+			perror("poll()");
+			break;
+		}
+
+		for(i = 0; i < nworkers; i++) {
+			crawl_worker *w = &workers[i];
+			rdirectory *rdir;
+			unsigned int j;
+
+			if(!w->busy)
+				continue;
+			for(j = 0; j < npfds && pfds[j].fd != w->fd; j++)
+				;
+			if(j == npfds || !pfds[j].revents)
+				continue;
+
+			w->busy = false;
+			if(cachefile_read_directory(w->fd, &rdir) != 0) {
+				close(w->fd);
+				w->fd = -1;
+				continue;
+			}
+			/* a directory the worker failed to list is left for the
+			 * command to list, and report any error */
+			if(rdir) {
+				ftp_cache_add(rdir);
+				crawl_expand(queue, rdir, exclude);
+			}
+		}
+	}
+
+	for(i = 0; i < nworkers; i++) {
+		if(workers[i].fd != -1)
+			close(workers[i].fd);
+	}
+	for(i = 0; i < nworkers; i++)
+		waitpid(workers[i].pid, 0, 0);
+
+	if(ftp_cache_full())
+		ftp_trace("directory cache full, stopped crawling\n");
+
+	free(pfds);
+	free(workers);
+}
+
+/* reads the directories in GL and all their subdirectories into the
+ * cache of the current connection, using up to N extra connections;
+ * directories and subdirectories for which EXCLUDE returns true are
+ * skipped
+ *
+ * directories already cached aren't listed again, and nothing is done
+ * if the cache gets full. This is only a prefetch, errors are left to
+ * the command walking the tree
+ */
+void ftp_crawl(list *gl, unsigned int n, rglobfunc exclude)
+{
+	list *queue;
+	listitem *li;
+	int verbosity;
+
+	if(n == 0 || !ftp_loggedin())
+		return;
+#ifdef HAVE_LIBSSH
+	if(ftp->session)
+		return;
+#endif
+
+	queue = list_new((listfunc)free);
+	for(li = gl->first; li; li = li->next) {
+		rfile *f = (rfile *)li->data;
+		if(crawl_want(f, exclude))
+			crawl_visit(queue, f->path, exclude);
+	}
+
+	/* list on this connection while there is only one directory to
+	 * list, there is nothing to gain from extra connections yet;
+	 * errors are reported when the command lists the directory again */
+	verbosity = ftp->verbosity;
+	ftp_set_verbosity(vbNone);
+	while(list_numitem(queue) == 1 && !gvInterrupted && !ftp_cache_full()) {
+		char *path = xstrdup((char *)queue->first->data);
+		rdirectory *rdir;
+
+		list_delitem(queue, queue->first);
+		rdir = ftp_read_directory(path);
+		if(rdir)
+			crawl_expand(queue, rdir, exclude);
+		free(path);
+	}
+	ftp_set_verbosity(verbosity);
+
+	if(list_numitem(queue) > 1 && !gvInterrupted && !ftp_cache_full()) {
+		list *conns = ftp_pool_acquire(min(n,
+											 (unsigned int)list_numitem(queue)));
+
+		ftp_trace("crawling %d directories over %d connections\n",
+				  list_numitem(queue), list_numitem(conns));
+		if(list_numitem(conns) > 0)
+			crawl_parallel(queue, conns, exclude);
+		list_free(conns);
+	}
+
+	list_free(queue);
+}
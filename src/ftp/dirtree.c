@@ -0,0 +1,148 @@
+/*
+ * dirtree.c -- tree of remote directories known to exist
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#include "syshdr.h"
+
+#include "dirtree.h"
+#include "xmalloc.h"
+
+typedef struct dirnode
+{
+	char *name;
+	struct dirnode *child;   /* first subdirectory */
+	struct dirnode *next;    /* next sibling */
+} dirnode;
+
+struct dirtree
+{
+	dirnode root;            /* "/" */
+};
+
+dirtree *dirtree_new(void)
+{
+	return (dirtree *)xmalloc(sizeof(dirtree));
+}
+
+static void dirnode_free(dirnode *n)
+{
+	while(n) {
+		dirnode *next = n->next;
+		dirnode_free(n->child);
+		free(n->name);
+		free(n);
+		n = next;
+	}
+}
+
+void dirtree_free(dirtree *tree)
+{
+	if(!tree)
+		return;
+	dirnode_free(tree->root.child);
+	free(tree);
+}
+
+/* returns the next component of *PATH and its length in *LEN, and
+ * advances *PATH past it, or returns 0 at the end of the path
+ */
+static const char *next_component(const char **path, size_t *len)
+{
+	const char *p = *path;
+
+	while(*p == '/')
+		p++;
+	if(!*p)
+		return 0;
+	*len = strcspn(p, "/");
+	*path = p + *len;
+	return p;
+}
+
+/* returns the subdirectory NAME of PARENT, or 0 if not known
+ *
+ * the subdirectory is moved first among its siblings, a recursive
+ * transfer uses the same directory many times in a row
+ */
+static dirnode *find_child(dirnode *parent, const char *name, size_t len)
+{
+	dirnode *n, *prev = 0;
+
+	for(n = parent->child; n; prev = n, n = n->next) {
+		if(strncmp(n->name, name, len) == 0 && n->name[len] == 0)
+			break;
+	}
+	if(n && prev) {
+		prev->next = n->next;
+		n->next = parent->child;
+		parent->child = n;
+	}
+	return n;
+}
+
+/* returns true if PATH is known to exist */
+bool dirtree_contains(dirtree *tree, const char *path)
+{
+	dirnode *n = &tree->root;
+	const char *name;
+	size_t len;
+
+	if(*path != '/')
+		return false;
+	while(n && (name = next_component(&path, &len)) != 0)
+		n = find_child(n, name, len);
+	return n != 0;
+}
+
+/* records that PATH, and thus all its parents, exists */
+void dirtree_add(dirtree *tree, const char *path)
+{
+	dirnode *n = &tree->root;
+	const char *name;
+	size_t len;
+
+	if(*path != '/')
+		return;
+	while((name = next_component(&path, &len)) != 0) {
+		dirnode *c = find_child(n, name, len);
+		if(!c) {
+			c = (dirnode *)xmalloc(sizeof(dirnode));
+			c->name = xstrndup(name, len);
+			c->next = n->child;
+			n->child = c;
+		}
+		n = c;
+	}
+}
+
+/* forgets PATH and everything below it, after it was removed or
+ * renamed
+ */
+void dirtree_remove(dirtree *tree, const char *path)
+{
+	dirnode *parent = 0, *n = &tree->root;
+	const char *name;
+	size_t len;
+
+	if(*path != '/')
+		return;
+	while(n && (name = next_component(&path, &len)) != 0) {
+		parent = n;
+		n = find_child(n, name, len);
+	}
+	if(!n || !parent)
+		return;
+
+	/* find_child() moved N first */
+	parent->child = n->next;
+	n->next = 0;
+	dirnode_free(n);
+}
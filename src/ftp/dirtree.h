@@ -0,0 +1,27 @@
+/*
+ * dirtree.h -- tree of remote directories known to exist
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#ifndef _dirtree_h_included
+#define _dirtree_h_included
+
+#include <stdbool.h>
+
+/* paths are absolute, without trailing slash and NOT quoted */
+typedef struct dirtree dirtree;
+
+dirtree *dirtree_new(void);
+void dirtree_free(dirtree *tree);
+bool dirtree_contains(dirtree *tree, const char *path);
+void dirtree_add(dirtree *tree, const char *path);
+void dirtree_remove(dirtree *tree, const char *path);
+
+#endif
@@ -39,8 +39,9 @@ Ftp *ftp_create(void)
 
     ftp->verbosity = vbCommand;
     ftp->tmp_verbosity = vbUnset;
-    ftp->last_mkpath = 0;
-    ftp->cache = list_new((listfunc)rdir_destroy);
+    ftp->known_dirs = dirtree_new();
+    ftp->failed_dirs = dirtree_new();
+    ftp->cache = ftp_cache_create();
     ftp->dirs_to_flush = list_new((listfunc)free);
     ftp->reply_timeout = 30;
     ftp->open_timeout = 30;
@@ -114,13 +115,19 @@ void ftp_destroy(Ftp *ftp)
         return;
 
     list_free(ftp->dirs_to_flush);
-    list_free(ftp->cache);
-    ftp->cache = ftp->dirs_to_flush = 0;
+    ftp_cache_destroy(ftp->cache);
+    dirtree_free(ftp->known_dirs);
+    dirtree_free(ftp->failed_dirs);
+    ftp->dirs_to_flush = 0;
+    ftp->cache = 0;
+    ftp->known_dirs = 0;
+    ftp->failed_dirs = 0;
     host_destroy(ftp->host);
     sock_destroy(ftp->data);
+    sock_destroy(ftp->next_data);
     sock_destroy(ftp->ctrl);
     ftp->host = NULL;
-    ftp->data = ftp->ctrl = NULL;
+    ftp->data = ftp->next_data = ftp->ctrl = NULL;
     url_destroy(ftp->url);
     ftp->url = NULL;
     free(ftp->homedir);
@@ -173,6 +180,10 @@ void ftp_reset_vars(void)
     sock_destroy(ftp->data);
     ftp->data = NULL;
 
+    sock_destroy(ftp->next_data);
+    ftp->next_data = NULL;
+    ftp->lookahead = false;
+
     sock_destroy(ftp->ctrl);
     ftp->ctrl = NULL;
 
@@ -203,12 +214,22 @@ void ftp_reset_vars(void)
     ftp->has_site_chmod_command = true;
     ftp->has_site_idle_command = true;
     ftp->has_mlsd_command = true;
+    ftp->has_rest_command = true;
+    ftp->rest_checked = false;
+    ftp->hash_types = 0;
+    ftp->xhash_types = 0;
+    ftp->hash_selected = csNone;
+    ftp->ssh_hash_probed = false;
+    ftp->verify = false;
+    ftp->data_checksum = 0;
+    ftp->data_bufsize = 0;
+    ftp->pending_replies = 0;
 
     list_free(ftp->dirs_to_flush);
     ftp->dirs_to_flush = list_new((listfunc)free);
 
-    list_free(ftp->cache);
-    ftp->cache = list_new((listfunc)rdir_destroy);
+    ftp_cache_destroy(ftp->cache);
+    ftp->cache = ftp_cache_create();
 
     /* don't assume server is in ascii mode initially even if RFC says so */
     ftp->prev_type = '?';
@@ -218,8 +239,9 @@ void ftp_reset_vars(void)
 
     ftp->reply_timeout = gvCommandTimeout;
 
-    free(ftp->last_mkpath);
-    ftp->last_mkpath = 0;
+    dirtree_free(ftp->known_dirs);
+    ftp->known_dirs = dirtree_new();
+    ftp_mkpath_done();
 
 #ifdef SECFTP
     sec_end();
@@ -239,6 +261,7 @@ void ftp_close(void)
     if(gvLoadTaglist != 0) {
         save_taglist(0);
     }
+    ftp_cache_save();
     ftp_reset_vars();
 }
 
@@ -251,6 +274,7 @@ void ftp_quit_all(void)
         ftp_use((Ftp *)li->data);
         ftp_quit();
     }
+    ftp_pool_quit_all();
 }
 
 #ifdef HAVE_POSIX_SIGSETJMP
@@ -586,6 +610,9 @@ static void reply_ALRM_handler(int signum)
         exit_yafc();
 }
 
+/* if set, gets each line of a multiline reply after the first one */
+static void (*reply_line_func)(const char *line) = 0;
+
 /* reads reply
  * returns 0 on success or -1 on error
  */
@@ -622,6 +649,8 @@ int ftp_read_reply(void)
             if(ftp_gets() == -1)
                 break;
             ftp_print_reply();
+            if(reply_line_func)
+                reply_line_func(ftp->reply);
         } while(strncmp(tmp, ftp->reply, 4) != 0);
     }
     ftp->tmp_verbosity = vbUnset;
@@ -670,6 +699,10 @@ int ftp_cmd(const char *cmd, ...)
         return -1;
     }
 
+    /* replies to pipelined commands would be taken as ours */
+    if(ftp->pending_replies > 0)
+        ftp_cmd_unwind();
+
     ftp_set_abort_handler();
 
   ugly:
@@ -722,6 +755,101 @@ int ftp_cmd(const char *cmd, ...)
     return resp;
 }
 
+/* sends an FTP command on the control channel without waiting for the
+ * reply, which is read later by ftp_cmd_reply(), in order
+ * the command is buffered until the next ftp_cmd_reply(), so several
+ * commands can go out in one write
+ * returns 0 on success or -1 on error
+ */
+int ftp_cmd_send(const char *cmd, ...)
+{
+    va_list ap;
+
+    if(!sock_connected(ftp->ctrl)) {
+        ftp_err(_("No control connection\n"));
+        ftp->code = ctNone;
+        ftp->fullcode = -1;
+        return -1;
+    }
+
+    va_start(ap, cmd);
+    sock_krb_vprintf(ftp->ctrl, cmd, ap);
+    sock_printf(ftp->ctrl, "\r\n");
+    va_end(ap);
+
+    if(sock_error_out(ftp->ctrl)) {
+        ftp_err(_("error writing command"));
+        ftp_err(" (");
+        va_start(ap, cmd);
+        vfprintf(stderr, cmd, ap);
+        va_end(ap);
+        ftp_err(")\n");
+        ftp->code = ctNone;
+        ftp->fullcode = -1;
+        return -1;
+    }
+
+    va_start(ap, cmd);
+    ftp_print_cmd(cmd, ap);
+    va_end(ap);
+
+    ftp->pending_replies++;
+    return 0;
+}
+
+/* flushes the commands sent by ftp_cmd_send() and reads the reply to
+ * the oldest one still waiting for it
+ * returns reply status code on success or -1 on error
+ */
+int ftp_cmd_reply(void)
+{
+    int resp;
+
+    if(ftp->pending_replies == 0) {
+        ftp_trace("ftp_cmd_reply() without a pending command\n");
+        ftp->code = ctNone;
+        ftp->fullcode = -1;
+        return -1;
+    }
+
+    sock_flush(ftp->ctrl);
+    if(sock_error_out(ftp->ctrl)) {
+        ftp_err(_("error writing command\n"));
+        ftp->pending_replies = 0;
+        ftp->code = ctNone;
+        ftp->fullcode = -1;
+        return -1;
+    }
+
+    ftp_set_abort_handler();
+    ftp->pending_replies--;
+    resp = ftp_read_reply();
+    ftp_set_close_handler();
+    if(resp == -1)
+        ftp->pending_replies = 0;
+    else if(resp == 421) { /* server is closing control connection! */
+        ftp_err(_("Server closed control connection\n"));
+        ftp->pending_replies = 0;
+        ftp->fullcode = 421;
+        ftp->code = 4;
+        return -1;
+    }
+    return resp;
+}
+
+/* reads and discards the replies to all commands sent by
+ * ftp_cmd_send() that are still waiting for one, used to recover
+ * when an earlier command in a pipeline failed
+ */
+void ftp_cmd_unwind(void)
+{
+    while(ftp->pending_replies > 0) {
+        ftp_set_tmp_verbosity(vbNone);
+        if(ftp_cmd_reply() == -1)
+            break;
+    }
+}
+
 void ftp_quit(void)
 {
 #ifdef HAVE_LIBSSH
@@ -1204,6 +1332,7 @@ int ftp_chdir(const char *path)
             ftp_trace("Parsed cwd '%s' from reply\n", ftp->curdir);
         } else
             ftp_update_curdir();
+        dirtree_add(ftp->known_dirs, ftp->curdir);
         return 0;
     }
     return -1;
@@ -1264,6 +1393,9 @@ int ftp_rmdir(const char *path)
     ftp_set_tmp_verbosity(vbError);
     ftp_cmd("RMD %s", p);
     if(ftp->code == ctComplete) {
+        char *ap = ftp_path_absolute(p);
+        dirtree_remove(ftp->known_dirs, ap);
+        free(ap);
         ftp_cache_flush_mark(p);
         ftp_cache_flush_mark_for(p);
     }
@@ -1286,6 +1418,67 @@ int ftp_unlink(const char *path)
     return -1;
 }
 
+/* removes the files in PATHS, a list of strings, sending the DELE
+ * commands without waiting for each reply; REPORT is called with the
+ * outcome for each file, in order, and can get the server's reply with
+ * ftp_getreply()
+ *
+ * at most FTP_PIPELINE_WINDOW commands are waiting for a reply, so the
+ * server never blocks writing replies we don't read yet
+ *
+ * returns the number of files not removed, or -1 if the control
+ * connection was lost
+ */
+int ftp_unlink_list(list *paths, ftp_remove_func report, void *arg)
+{
+    listitem *li, *next_li;
+    unsigned int pending = 0;
+    int failed = 0;
+
+#ifdef HAVE_LIBSSH
+    if(ftp->session) {
+        for(li = paths->first; li; li = li->next) {
+            bool ok = ssh_unlink((char *)li->data) == 0;
+            if(!ok)
+                failed++;
+            if(report)
+                report((char *)li->data, ok, arg);
+        }
+        return failed;
+    }
+#endif
+
+    next_li = paths->first;
+    for(li = paths->first; li; li = li->next) {
+        const char *path = (const char *)li->data;
+        bool ok;
+
+        while(next_li && pending < FTP_PIPELINE_WINDOW) {
+            ftp_set_tmp_verbosity(vbNone);
+            if(ftp_cmd_send("DELE %s", (char *)next_li->data) != 0) {
+                ftp_cmd_unwind();
+                return -1;
+            }
+            next_li = next_li->next;
+            pending++;
+        }
+
+        ftp_set_tmp_verbosity(vbNone);
+        if(ftp_cmd_reply() == -1)
+            return -1;
+        pending--;
+
+        ok = (ftp->code == ctComplete);
+        if(ok)
+            ftp_cache_flush_mark_for(path);
+        else
+            failed++;
+        if(report)
+            report(path, ok, arg);
+    }
+    return failed;
+}
+
 int ftp_chmod(const char *path, const char *mode)
 {
 #ifdef HAVE_LIBSSH
@@ -1363,15 +1556,24 @@ int ftp_help(const char *arg)
     return ftp->code == ctComplete ? 0 : -1;
 }
 
-unsigned long long ftp_filesize(const char *path)
+/* returns the size of the remote file PATH, or -1 on error
+ * unless FORCE is true, an exact size in the directory cache is used
+ */
+unsigned long long ftp_filesize(const char *path, bool force)
 {
     unsigned long long ret;
+    rfile *f;
 
 #ifdef HAVE_LIBSSH
     if(ftp->session)
         return ssh_filesize(path);
 #endif
 
+    /* the size from MLSD or an earlier SIZE is as good as a new SIZE */
+    f = ftp_cache_get_file(path);
+    if(f && (f->exact & RFILE_EXACT_SIZE) && !force)
+        return f->size;
+
     if(!ftp->has_size_command)
         return -1;
     if(ftp_type(tmBinary) != 0)
@@ -1384,19 +1586,108 @@ unsigned long long ftp_filesize(const char *path)
     }
     if(ftp->code == ctComplete) {
         sscanf(ftp->reply, "%*s %llu", &ret);
+        if(f) {
+            f->size = ret;
+            f->exact |= RFILE_EXACT_SIZE;
+        }
         return ret;
     }
     return -1;
 }
 
+/* returns the checksum to verify transfers with, the strongest one the
+ * server can compute, or csNone if it can't
+ */
+checksum_t ftp_checksum_type(void)
+{
+    unsigned int types = ftp->hash_types | ftp->xhash_types;
+
+#ifdef HAVE_LIBSSH
+    if(ftp->session)
+        types = ssh_checksum_types();
+#endif
+
+    if(types & csSHA256)
+        return csSHA256;
+    if(types & csMD5)
+        return csMD5;
+    if(types & csCRC32)
+        return csCRC32;
+    return csNone;
+}
+
+/* asks the server for the checksum TYPE of the remote file PATH
+ * returns the checksum in hex (malloc'd) or 0 on error
+ */
+char *ftp_checksum(const char *path, checksum_t type)
+{
+    const char *e;
+    size_t len;
+
+#ifdef HAVE_LIBSSH
+    if(ftp->session)
+        return ssh_checksum(path, type);
+#endif
+
+    if(ftp->hash_types & type) {
+        if(ftp->hash_selected != type) {
+            ftp_set_tmp_verbosity(vbError);
+            ftp_cmd("OPTS HASH %s", checksum_name(type));
+            if(ftp->code != ctComplete)
+                return 0;
+            ftp->hash_selected = type;
+        }
+        /* 213 SHA-256 0-49 169cd22282da7f147cb491e559e9dd filename */
+        ftp_set_tmp_verbosity(vbError);
+        ftp_cmd("HASH %s", path);
+        if(ftp->code != ctComplete)
+            return 0;
+        e = ftp_getreply(false);
+        e += strcspn(e, " ");
+        e += strspn(e, " ");
+        e += strcspn(e, " ");
+    } else if(ftp->xhash_types & type) {
+        /* 250 169CD22282DA7F147CB491E559E9DD */
+        ftp_set_tmp_verbosity(vbError);
+        ftp_cmd("%s %s", type == csSHA256 ? "XSHA256"
+                : type == csMD5 ? "XMD5" : "XCRC", path);
+        if(ftp->code != ctComplete)
+            return 0;
+        e = ftp_getreply(false);
+    } else
+        return 0;
+
+    e += strspn(e, " ");
+    len = strspn(e, "0123456789abcdefABCDEF");
+    if(len == 0) {
+        ftp_err(_("%s: unexpected checksum reply: %s\n"),
+                path, ftp_getreply(false));
+        return 0;
+    }
+    return xstrndup(e, len);
+}
+
+/* lists with CMD and PARAM, parsing the listing of DIR into RDIR as
+ * it arrives
+ */
+static int ftp_list_rdir(const char *cmd, const char *param,
+                         rdirectory *rdir, const char *dir, bool is_mlsd)
+{
+    rdir_parser *parser = rdir_parse_begin(rdir, dir, is_mlsd);
+    int r;
+
+    r = ftp_list_func(cmd, param, rdir_parse_feed, parser);
+    if(rdir_parse_end(parser) != 0)
+        r = -1;
+    return r;
+}
+
 rdirectory *ftp_read_directory(const char *path)
 {
-    FILE *fp = 0;
     rdirectory *rdir;
     bool is_curdir = false;
     bool _failed = false;
     char *dir;
-    bool is_mlsd = false;
 
 #ifdef HAVE_LIBSSH
     if (ftp->session)
@@ -1407,12 +1698,7 @@ rdirectory *ftp_read_directory(const char *path)
     stripslash(dir);
 
     is_curdir = (strcmp(dir, ftp->curdir) == 0);
-
-    if((fp = tmpfile()) == NULL) {	/* can't create a tmpfile */
-        ftp_err("Unable to create temp file: %s\n", strerror(errno));
-        free(dir);
-        return 0;
-    }
+    rdir = rdir_create();
 
     /* we do a "CWD" before the listing, because: we want a listing of
      *  the directory contents, not the directory itself, and some
@@ -1426,7 +1712,6 @@ rdirectory *ftp_read_directory(const char *path)
     }
 
     if(ftp->has_mlsd_command) {
-        is_mlsd = true;
 #if 0
         /* PureFTPd (1.0.11) doesn't recognize directory arguments
          * with spaces, not even quoted, it just chops the argument
@@ -1439,17 +1724,16 @@ rdirectory *ftp_read_directory(const char *path)
          * doing a 'MLSD link-to-dir' on PureFTPd closes the control
          * connection, however, 'MLSD link-to-dir/' works fine.
          */
-        _failed = (ftp_list("MLSD", asdf, fp) != 0);
+        _failed = (ftp_list_rdir("MLSD", asdf, rdir, dir, true) != 0);
         free(asdf);
 #else
-        _failed = (ftp_list("MLSD", 0, fp) != 0);
+        _failed = (ftp_list_rdir("MLSD", 0, rdir, dir, true) != 0);
 #endif
         if(_failed && ftp->code == ctError)
             ftp->has_mlsd_command = false;
     }
     if(!ftp->has_mlsd_command) {
-        _failed = (ftp_list("LIST", 0, fp) != 0);
-        is_mlsd = false;
+        _failed = (ftp_list_rdir("LIST", 0, rdir, dir, false) != 0);
     }
 
     if(!is_curdir)
@@ -1458,25 +1742,14 @@ rdirectory *ftp_read_directory(const char *path)
     if(_failed)
         goto failed;
 
-    rewind(fp);
-
-    rdir = rdir_create();
-    if(rdir_parse(rdir, fp, dir, is_mlsd) != 0) {
-        rdir_destroy(rdir);
-        goto failed;
-    }
-
-    fclose(fp);
-    ftp_trace("added directory '%s' to cache\n", dir);
-    list_additem(ftp->cache, rdir);
+    ftp_cache_add(rdir);
     free(dir);
 
     rdir_sort(rdir);
     return rdir;
 
 failed: /* forgive me father, for I have goto'ed */
-    if (fp)
-        fclose(fp);
+    rdir_destroy(rdir);
     free(dir);
     return NULL;
 }
@@ -1490,6 +1763,8 @@ rdirectory *ftp_get_directory(const char *path)
     stripslash(ap);
 
     rdir = ftp_cache_get_directory(ap);
+    if(!rdir)
+        rdir = ftp_cache_load_directory(ap);
     if(!rdir)
         rdir = ftp_read_directory(ap);
     free(ap);
@@ -1549,9 +1824,35 @@ static bool ftp_path_part_of(const char *a, const char *b)
     return false;
 }
 
+/* returns true if the directory PATH is known to exist: it has been
+ * created or visited before, is a parent of the current directory, or
+ * shows up in the directory cache
+ */
+static bool ftp_dir_known(const char *path)
+{
+    char *ap = ftp_path_absolute(path);
+    bool known;
+    rfile *f;
+
+    stripslash(ap);
+    known = dirtree_contains(ftp->known_dirs, ap);
+    if(!known && (ftp_path_part_of(ap, ftp->curdir)
+                  || ftp_cache_get_directory(ap)
+                  || ((f = ftp_cache_get_file(ap)) != 0 && risdir(f))))
+    {
+        dirtree_add(ftp->known_dirs, ap);
+        known = true;
+    }
+    free(ap);
+    return known;
+}
+
 /* creates path (and all elements in path)
  * PATH should be an absolute path
  * returns -1 on error, 0 if no directories created, else 1
+ *
+ * directories known to exist are skipped, and so are those MKD has
+ * failed for since the last ftp_mkpath_done()
  */
 int ftp_mkpath(const char *path)
 {
@@ -1561,18 +1862,16 @@ int ftp_mkpath(const char *path)
     if(!path)
         return 0;
 
-    /* check if we already has created this path */
-    if(ftp_path_part_of(path, ftp->last_mkpath))
-        return 0;
-
-    /* check if this path is a part of current directory */
-    if(ftp_path_part_of(path, ftp->curdir))
-        return 0;
-
     orgp = p = xstrdup(path);
     path_collapse(p);
     unquote(p);
 
+    /* check if we already has created this path */
+    if(ftp_dir_known(p)) {
+        free(orgp);
+        return 0;
+    }
+
     if(*p == '/') {
         e = xmalloc(1);
         *e = 0;
@@ -1600,28 +1899,40 @@ int ftp_mkpath(const char *path)
         free(e);
         e = foo;
 
-        /* check if we already has created this path */
-        if(ftp_path_part_of(e, ftp->last_mkpath))
-            continue;
-
-        /* check if this path is a part of current directory */
-        if(ftp_path_part_of(e, ftp->curdir))
+        if(strncmp(e, ".", 2) == 0 || ftp_dir_known(e))
             continue;
 
-        if(strncmp(e, ".", 2) != 0) {
-            ftp_mkdir_verb(e, vbNone);
-            one_created = (ftp->code == ctComplete);
+        {
+            char *ae = ftp_path_absolute(e);
+            stripslash(ae);
+            if(!dirtree_contains(ftp->failed_dirs, ae)) {
+                ftp_mkdir_verb(e, vbNone);
+                one_created = (ftp->code == ctComplete);
+
+                /* if MKD failed, the directory most likely exists
+                 * already, but it may just as well not be allowed; only
+                 * this command won't try again */
+                dirtree_add(one_created ? ftp->known_dirs
+                            : ftp->failed_dirs, ae);
+            }
+            free(ae);
         }
     }
 
-    free(ftp->last_mkpath);
-    ftp->last_mkpath = path_absolute(path, ftp->curdir, ftp->homedir);
-
     free(e);
     free(orgp);
     return one_created;
 }
 
+/* forgets the directories ftp_mkpath() failed to create, called when a
+ * command is done with them
+ */
+void ftp_mkpath_done(void)
+{
+    dirtree_free(ftp->failed_dirs);
+    ftp->failed_dirs = dirtree_new();
+}
+
 char *ftp_path_absolute(const char *path)
 {
     return path_absolute(path, ftp->curdir, ftp->homedir);
@@ -1682,6 +1993,13 @@ int ftp_rename(const char *oldname, const char *newname)
         return -1;
     }
 
+    {
+        /* ON may have been a directory */
+        char *aon = ftp_path_absolute(on);
+        dirtree_remove(ftp->known_dirs, aon);
+        free(aon);
+    }
+
     ftp_cache_flush_mark_for(on);
     ftp_cache_flush_mark_for(nn);
     return 0;
@@ -1770,6 +2088,28 @@ time_t gmt_mktime(const struct tm *ts)
     return gmt;
 }
 
+/* returns the time in the reply to MDTM, (time_t)-1 if the server
+ * doesn't support MDTM, or (time_t)1 on other errors
+ */
+static time_t ftp_mdtm_reply(void)
+{
+    struct tm ts;
+
+    if (ftp->fullcode == 202) {
+        ftp->has_mdtm_command = false;
+        return (time_t)-1;
+    }
+    if (ftp->fullcode != 213)
+        return (time_t)1;
+    /* time is Universal Coordinated Time */
+    memset(&ts, 0, sizeof(ts));
+    sscanf(ftp->reply, "%*s %04d%02d%02d%02d%02d%02d", &ts.tm_year,
+           &ts.tm_mon, &ts.tm_mday, &ts.tm_hour, &ts.tm_min, &ts.tm_sec);
+    ts.tm_year -= 1900;
+    ts.tm_mon--;
+    return gmt_mktime(&ts);
+}
+
 /*
 ** Function:    time_t ftp_filetime(const char *filename)
 **
@@ -1781,6 +2121,9 @@ time_t gmt_mktime(const struct tm *ts)
 */
 time_t ftp_filetime(const char *filename, bool force)
 {
+    rfile *f;
+    time_t t;
+
     if (!ftp_connected())
         return -1;
 
@@ -1789,32 +2132,77 @@ time_t ftp_filetime(const char *filename, bool force)
         return ssh_filetime(filename);
 #endif
 
-    if (!force)
-    {
-        rfile* f = ftp_cache_get_file(filename);
-        if (f && f->mtime != (time_t)-1)
-            return f->mtime;
-    }
+    /* a time from MLSD or an earlier MDTM is as good as a new MDTM */
+    f = ftp_cache_get_file(filename);
+    if (f && f->mtime != (time_t)-1
+        && (!force || (f->exact & RFILE_EXACT_MTIME)))
+        return f->mtime;
 
     if (!ftp->has_mdtm_command)
         return (time_t)-1;
 
-    struct tm ts;
-    memset(&ts, 0, sizeof(ts));
     ftp_set_tmp_verbosity(vbNone);
     ftp_cmd("MDTM %s", filename);
-    if (ftp->fullcode == 202) {
-        ftp->has_mdtm_command = false;
-        return (time_t)-1;
+    t = ftp_mdtm_reply();
+    if (f && ftp->fullcode == 213) {
+        f->mtime = t;
+        f->exact |= RFILE_EXACT_MTIME;
     }
-    if (ftp->fullcode != 213)
-        return (time_t)1;
-    /* time is Universal Coordinated Time */
-    sscanf(ftp->reply, "%*s %04d%02d%02d%02d%02d%02d", &ts.tm_year,
-           &ts.tm_mon, &ts.tm_mday, &ts.tm_hour, &ts.tm_min, &ts.tm_sec);
-    ts.tm_year -= 1900;
-    ts.tm_mon--;
-    return gmt_mktime(&ts);
+    return t;
+}
+
+/* sends MDTM, pipelined, for the files in GL (a list of rfile) that
+ * ftp_filetime() with FORCE would otherwise ask about one at a time, and
+ * stores the replies in the directory cache for it to find
+ */
+void ftp_filetime_prefetch(list *gl, bool force)
+{
+    listitem *li;
+    rfile **files;
+    unsigned int i, n = 0, sent = 0, nfiles;
+
+    if (!ftp_connected() || !ftp->has_mdtm_command)
+        return;
+#ifdef HAVE_LIBSSH
+    if (ftp->session)
+        return;
+#endif
+
+    files = xmalloc((list_numitem(gl) + 1) * sizeof(rfile *));
+    for (li = gl->first; li; li = li->next) {
+        rfile *f = ftp_cache_get_file(((rfile *)li->data)->path);
+        if (f && risreg(f) && (f->mtime == (time_t)-1
+                               || (force && !(f->exact & RFILE_EXACT_MTIME))))
+            files[n++] = f;
+    }
+    nfiles = n;
+    if (nfiles > 1)
+        ftp_trace("asking for the time of %u files at once\n", nfiles);
+
+    for (i = 0; i < nfiles && nfiles > 1; i++) {
+        time_t t;
+
+        while (sent < nfiles && sent - i < FTP_PIPELINE_WINDOW) {
+            ftp_set_tmp_verbosity(vbNone);
+            if (ftp_cmd_send("MDTM %s", files[sent]->path) != 0)
+                break;
+            sent++;
+        }
+        if (i == sent)
+            break;
+
+        ftp_set_tmp_verbosity(vbNone);
+        if (ftp_cmd_reply() == -1)
+            break;
+        t = ftp_mdtm_reply();
+        if (ftp->fullcode == 213) {
+            files[i]->mtime = t;
+            files[i]->exact |= RFILE_EXACT_MTIME;
+        } else if (!ftp->has_mdtm_command)
+            break;
+    }
+    ftp_cmd_unwind();
+    free(files);
 }
 
 int ftp_maybe_isdir(rfile *fp)
@@ -1899,9 +2287,57 @@ char *perm2string(int perm)
     return attr;
 }
 
+/* records the checksums of HASH and the X* commands in a line of the
+ * FEAT reply, such as " HASH SHA-256*;SHA-1;MD5" where * marks the
+ * one HASH currently computes
+ */
+static void ftp_feat_line(const char *line)
+{
+    checksum_t type;
+
+    if(*line != ' ')
+        return;
+    line++;
+
+    if(strncasecmp(line, "HASH ", 5) == 0) {
+        line += 5;
+        while(*line) {
+            size_t len = strcspn(line, ";*");
+            type = checksum_lookup(line, len);
+            ftp->hash_types |= type;
+            line += len;
+            if(*line == '*') {
+                ftp->hash_selected = type;
+                line++;
+            }
+            if(*line == ';')
+                line++;
+        }
+    } else if(strcasecmp(line, "XCRC") == 0)
+        ftp->xhash_types |= csCRC32;
+    else if(strcasecmp(line, "XMD5") == 0)
+        ftp->xhash_types |= csMD5;
+    else if(strcasecmp(line, "XSHA256") == 0)
+        ftp->xhash_types |= csSHA256;
+}
+
+/* asks the server which optional commands it supports */
 void ftp_get_feat(void)
 {
-/*  ftp_cmd("FEAT");*/
+    ftp->hash_types = 0;
+    ftp->xhash_types = 0;
+    ftp->hash_selected = csNone;
+    ftp->ssh_hash_probed = false;
+
+#ifdef HAVE_LIBSSH
+    if(ftp->session)
+        return;
+#endif
+
+    reply_line_func = ftp_feat_line;
+    ftp_set_tmp_verbosity(vbNone);
+    ftp_cmd("FEAT");
+    reply_line_func = 0;
 }
 
 char* ftp_connected_user()
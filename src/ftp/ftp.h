@@ -24,6 +24,8 @@
 #include "rfile.h"
 #include "ftpsigs.h"
 #include "rglob.h"
+#include "dirtree.h"
+#include "checksum.h"
 #include "args.h"
 
 #ifdef HAVE_LIBSSH
@@ -34,6 +36,10 @@
 #define MAXREPLY 512      /* max size of (one line of) reply string */
 
 #define FTP_BUFSIZ 4096
+#define FTP_MAXBUFSIZ (4*1024*1024) /* limit of the adaptive data buffer */
+#define FTP_SPLICE_SIZE 65536 /* bytes moved per splice(), the pipe size */
+#define FTP_SENDFILE_SIZE (1024*1024) /* bytes sent per sendfile() */
+#define FTP_PIPELINE_WINDOW 64 /* commands sent ahead of their replies */
 
 #define ALARM_SEC 0
 #define ALARM_USEC 500000
@@ -112,9 +118,16 @@ typedef struct transfer_info
 	bool transfer_is_put;        /* true if transfer is put (upload) */
 	bool finished;               /* set when transfer finished */
 	bool begin;
+	bool checksum_mismatch;      /* set when the file failed verification */
 } transfer_info;
 
 typedef void (*ftp_transfer_func)(transfer_info *ti);
+/* receives N bytes of data, returns non-zero to stop the transfer */
+typedef int (*ftp_data_func)(char *data, size_t n, void *arg);
+typedef void (*ftp_remove_func)(const char *path, bool removed, void *arg);
+
+/* the directory cache, in cache.c */
+typedef struct dircache dircache;
 
 typedef struct Ftp
 {
@@ -123,7 +136,7 @@ typedef struct Ftp
 	Host *host;
 	url_t *url;
 
-	list *cache;             /* list of rdirectory */
+	dircache *cache;         /* cached rdirectories */
 	list *dirs_to_flush;     /* list of (char *) */
 
 #ifdef HAVE_LIBSSH
@@ -154,8 +167,20 @@ typedef struct Ftp
 	bool has_site_chmod_command;
 	bool has_site_idle_command;
 	bool has_mlsd_command;
+	bool has_rest_command;
+	bool rest_checked;    /* has_rest_command was checked with REST 0 */
+	unsigned int hash_types;   /* checksums HASH knows, see ftp_get_feat() */
+	unsigned int xhash_types;  /* checksums of XCRC, XMD5, XSHA256 or ssh */
+	bool ssh_hash_probed;      /* see ssh_checksum_types() */
+	checksum_t hash_selected;  /* the checksum HASH computes */
 
 	long restart_offset;  /* next transfer will be restarted at this offset */
+	size_t data_bufsize;  /* data buffer size learned by earlier transfers */
+	unsigned int pending_replies; /* commands sent by ftp_cmd_send() */
+	bool lookahead;       /* prepare the data connection of the next transfer */
+	Socket *next_data;    /* data connection prepared for the next transfer */
+	bool verify;          /* verify the checksum of binary transfers */
+	checksum *data_checksum; /* checksum of the data being transferred */
 
 	char *homedir;  /* home directory (curdir on startup) */
 	char *curdir;   /* current directory */
@@ -186,7 +211,8 @@ typedef struct Ftp
 	struct sec_client_mech *mech;
 #endif
 
-	char *last_mkpath; /* used to speed up ftp_mkpath() */
+	dirtree *known_dirs; /* directories known to exist, see ftp_mkpath() */
+	dirtree *failed_dirs; /* MKD failed during this command */
 
 	transfer_info ti;
 
@@ -206,6 +232,9 @@ int ftp_set_trace(const char *filename);
 
 void ftp_reply_timeout(unsigned int secs);
 int ftp_cmd(const char *cmd, ...) YAFC_PRINTF(1, 2);
+int ftp_cmd_send(const char *cmd, ...) YAFC_PRINTF(1, 2);
+int ftp_cmd_reply(void);
+void ftp_cmd_unwind(void);
 int ftp_reopen(void);
 int ftp_open_host(Host *hostp);
 int ftp_open_url(url_t *urlp, bool reset_vars);
@@ -219,12 +248,18 @@ int ftp_read_reply(void);
 const char *ftp_getreply(bool withcode);
 
 int ftp_list(const char *cmd, const char *param, FILE *fp);
+int ftp_list_func(const char *cmd, const char *param,
+				  ftp_data_func func, void *arg);
+void ftp_lookahead(bool on);
+void ftp_verify(bool on);
 int ftp_receive(const char *path, FILE *fp,
 				transfer_mode_t mode, ftp_transfer_func hookf);
 int ftp_getfile(const char *infile, const char *outfile, getmode_t how,
 				transfer_mode_t mode, ftp_transfer_func hookf);
 int ftp_putfile(const char *infile, const char *outfile, putmode_t how,
 				transfer_mode_t mode, ftp_transfer_func hookf);
+int ftp_getfile_segmented(const char *infile, const char *outfile,
+						  unsigned int segments, ftp_transfer_func hookf);
 int ftp_fxpfile(Ftp *srcftp, const char *srcfile,
 				Ftp *destftp, const char *destfile,
 				fxpmode_t how, transfer_mode_t mode);
@@ -244,8 +279,14 @@ char* ftp_connected_user();
 
 rdirectory *ftp_get_directory(const char *path);
 rdirectory *ftp_read_directory(const char *path);
+dircache *ftp_cache_create(void);
+void ftp_cache_destroy(dircache *cache);
+void ftp_cache_add(rdirectory *rdir);
 rdirectory *ftp_cache_get_directory(const char *path);
 rfile *ftp_cache_get_file(const char *path);
+rdirectory *ftp_cache_load_directory(const char *path);
+void ftp_cache_save(void);
+bool ftp_cache_full(void);
 rfile *ftp_get_file(const char *path);
 void ftp_cache_list_contents(void);
 void ftp_cache_flush_mark(const char *p);
@@ -253,19 +294,30 @@ void ftp_cache_flush_mark_for(const char *p);
 void ftp_cache_flush(void);
 void ftp_cache_clear(void);
 
+list *ftp_pool_acquire(unsigned int n);
+Ftp *ftp_pool_open(void);
+void ftp_pool_quit_all(void);
+void ftp_pool_detach(void);
+void ftp_crawl(list *gl, unsigned int n, rglobfunc exclude);
+
 char *ftp_getcurdir(void);
 void ftp_update_curdir_x(const char *p);
 
 int ftp_chdir(const char *path);
 int ftp_mkdir(const char *path);
 int ftp_mkpath(const char *path);
+void ftp_mkpath_done(void);
 int ftp_rmdir(const char *path);
 int ftp_rename(const char *oldname, const char *newname);
 int ftp_cdup(void);
 int ftp_unlink(const char *path);
+int ftp_unlink_list(list *paths, ftp_remove_func report, void *arg);
 int ftp_chmod(const char *path, const char *mode);
 time_t ftp_filetime(const char *filename, bool force);
-unsigned long long ftp_filesize(const char *path);
+void ftp_filetime_prefetch(list *gl, bool force);
+unsigned long long ftp_filesize(const char *path, bool force);
+checksum_t ftp_checksum_type(void);
+char *ftp_checksum(const char *path, checksum_t type);
 int ftp_idle(const char *idletime);
 int ftp_noop(void);
 int ftp_help(const char *arg);
@@ -20,6 +20,7 @@
 #ifdef HAVE_LIBSSH
 #include "ssh_cmd.h"
 #endif
+#include <fcntl.h>
 
 static bool is_private(struct sockaddr* sa)
 {
@@ -70,7 +71,38 @@ static bool is_reserved(struct sockaddr* sa)
   return false;
 }
 
-static bool ftp_pasv(bool ipv6, unsigned char* result, unsigned short* ipv6_port)
+/* sends TYPE if the server isn't already in mode TYPE, without waiting
+ * for the reply
+ * returns true if the reply must be read with ftp_type_reply()
+ */
+static bool ftp_type_send(transfer_mode_t type)
+{
+#ifdef HAVE_LIBSSH
+  if (ftp->session)
+    return false;
+#endif
+
+  if (type == tmCurrent || ftp->prev_type == type)
+    return false;
+
+  return ftp_cmd_send("TYPE %c", type == tmAscii ? 'A' : 'I') == 0;
+}
+
+static int ftp_type_reply(transfer_mode_t type)
+{
+  ftp_cmd_reply();
+  if (ftp->code != ctComplete)
+    return -1;
+  ftp->prev_type = type;
+  return 0;
+}
+
+static bool ftp_pasv_reply(bool ipv6, unsigned char* result,
+                           unsigned short* ipv6_port);
+
+/* requests passive mode, with TYPE for mode TYPE pipelined after it */
+static bool ftp_pasv(bool ipv6, transfer_mode_t type, unsigned char* result,
+                     unsigned short* ipv6_port)
 {
   if (!ftp->has_pasv_command) {
     ftp_err(_("Host doesn't support passive mode\n"));
@@ -79,15 +111,29 @@ static bool ftp_pasv(bool ipv6, unsigned char* result, unsigned short* ipv6_port
   ftp_set_tmp_verbosity(vbNone);
 
   /* request passive mode */
+  int r = -1;
   if (!ipv6)
-    ftp_cmd("PASV");
+    r = ftp_cmd_send("PASV");
 #ifdef HAVE_IPV6
   else if (ipv6)
-    ftp_cmd("EPSV");
+    r = ftp_cmd_send("EPSV");
 #endif
-  else
+  if (r != 0)
     return false;
 
+  const bool typed = ftp_type_send(type);
+  ftp_cmd_reply();
+
+  const bool ok = ftp_pasv_reply(ipv6, result, ipv6_port);
+  if (typed)
+    ftp_type_reply(type);
+  return ok;
+}
+
+/* parses the reply to PASV or EPSV */
+static bool ftp_pasv_reply(bool ipv6, unsigned char* result,
+                           unsigned short* ipv6_port)
+{
   if (!ftp_connected())
     return false;
 
@@ -138,24 +184,123 @@ static bool ftp_is_passive(void)
 	return ftp->url->pasvmode;
 }
 
-static int ftp_init_transfer(void)
+/* creates the socket for a new data connection in *DATA */
+static bool ftp_data_create(Socket **data)
+{
+  if (!sock_dup(ftp->ctrl, data))
+    return false;
+
+  /* in auto mode, the kernel buffers start at the size learned by
+   * previous transfers, or are left to the kernel */
+  if (gvTransferBuffer > 0)
+    sock_bufsize(*data, gvTransferBuffer);
+  else if (ftp->data_bufsize > 0)
+    sock_bufsize(*data, 2 * ftp->data_bufsize);
+  return true;
+}
+
+/* connects DATA to the address from a PASV (PAC) or EPSV (IPV6_PORT) reply */
+static bool ftp_pasv_connect(Socket *data, const unsigned char *pac,
+                             unsigned short ipv6_port)
+{
+  struct sockaddr_storage sa;
+  memcpy(&sa, sock_remote_addr(ftp->ctrl), sizeof(struct sockaddr_storage));
+
+  socklen_t len = sizeof(struct sockaddr_in);
+  if (sa.ss_family == AF_INET)
+  {
+    memcpy(&((struct sockaddr_in*)&sa)->sin_addr, pac, (size_t)4);
+    memcpy(&((struct sockaddr_in*)&sa)->sin_port, pac+4, (size_t)2);
+  }
+#ifdef HAVE_IPV6
+  else if (sa.ss_family == AF_INET6)
+  {
+    ((struct sockaddr_in6*)&sa)->sin6_port = htons(ipv6_port);
+    len = sizeof(struct sockaddr_in6);
+  }
+#endif
+  else
+  {
+    ftp_trace("Do not know how to handle family %d.\n", sa.ss_family);
+    return false;
+  }
+
+  struct sockaddr_storage tmp;
+  memcpy(&tmp, sock_remote_addr(ftp->ctrl), sizeof(struct sockaddr_storage));
+  if (is_reserved((struct sockaddr*) &sa) ||
+       is_multicast((struct sockaddr*) &sa)  ||
+       (is_private((struct sockaddr*) &sa) != is_private((struct sockaddr*) &tmp)) ||
+       (is_loopback((struct sockaddr*) &sa) != is_loopback((struct sockaddr*) &tmp)))
+  {
+    // Invalid address returned by PASV. Replace with address from control
+    // socket.
+    ftp_err(_("Address returned by PASV seems to be incorrect.\n"));
+    ((struct sockaddr_in*)&sa)->sin_addr = ((struct sockaddr_in*)&tmp)->sin_addr;
+  }
+
+  if (!sock_connect_addr(data, (struct sockaddr*) &sa, len))
+  {
+    ftp_trace("Could not connect to address from PASV/EPSV.\n");
+    perror("connect()");
+    return false;
+  }
+
+  return true;
+}
+
+/* takes the data connection prepared by ftp_lookahead_connect(), if
+ * it is still usable
+ */
+static bool ftp_use_next_data(void)
+{
+  Socket *data = ftp->next_data;
+  ftp->next_data = NULL;
+
+  if (!data)
+    return false;
+
+  /* nothing should arrive before the transfer command, so anything
+   * readable means the server has closed it */
+  char c;
+  const bool alive = ftp_is_passive() && sock_nonblocking(data, true)
+    && sock_read(data, &c, 1) == -1
+    && (errno == EAGAIN || errno == EWOULDBLOCK)
+    && sock_nonblocking(data, false);
+  if (!alive)
+  {
+    ftp_trace("prepared data connection is gone\n");
+    sock_destroy(data);
+    return false;
+  }
+
+  ftp_trace("using prepared data connection\n");
+  ftp->data = data;
+  return true;
+}
+
+/* sets up the data connection, and the transfer type MODE on the way */
+static int ftp_init_transfer(transfer_mode_t mode)
 {
   if (!ftp_connected())
     return -1;
 
-  if (!sock_dup(ftp->ctrl, &ftp->data))
+  if (ftp_use_next_data())
+  {
+    ftp_type(mode);
+    return 0;
+  }
+
+  if (!ftp_data_create(&ftp->data))
     return -1;
 
   if (ftp_is_passive())
   {
     ftp_trace("Initializing passive connection.\n");
 
-    struct sockaddr_storage sa;
-    memcpy(&sa, sock_remote_addr(ftp->ctrl), sizeof(struct sockaddr_storage));
-
+    const bool ipv6 = sock_remote_addr(ftp->ctrl)->sa_family != AF_INET;
     unsigned char pac[6] = { 0 };
     unsigned short ipv6_port = { 0 };
-    if (!ftp_pasv(sa.ss_family != AF_INET, pac, &ipv6_port))
+    if (!ftp_pasv(ipv6, mode, pac, &ipv6_port))
     {
       ftp_trace("PASV/EPSV failed.\n");
       sock_destroy(ftp->data);
@@ -163,44 +308,8 @@ static int ftp_init_transfer(void)
       return -1;
     }
 
-    socklen_t len = sizeof(struct sockaddr_in);
-    if (sa.ss_family == AF_INET)
-    {
-      memcpy(&((struct sockaddr_in*)&sa)->sin_addr, pac, (size_t)4);
-      memcpy(&((struct sockaddr_in*)&sa)->sin_port, pac+4, (size_t)2);
-    }
-#ifdef HAVE_IPV6
-    else if (sa.ss_family == AF_INET6)
-    {
-      ((struct sockaddr_in6*)&sa)->sin6_port = htons(ipv6_port);
-      len = sizeof(struct sockaddr_in6);
-    }
-#endif
-    else
-    {
-      ftp_trace("Do not know how to handle family %d.\n", sa.ss_family);
-      sock_destroy(ftp->data);
-      ftp->data = NULL;
-      return -1;
-    }
-
-    struct sockaddr_storage tmp;
-    memcpy(&tmp, sock_remote_addr(ftp->ctrl), sizeof(struct sockaddr_storage));
-    if (is_reserved((struct sockaddr*) &sa) ||
-         is_multicast((struct sockaddr*) &sa)  ||
-         (is_private((struct sockaddr*) &sa) != is_private((struct sockaddr*) &tmp)) ||
-         (is_loopback((struct sockaddr*) &sa) != is_loopback((struct sockaddr*) &tmp)))
+    if (!ftp_pasv_connect(ftp->data, pac, ipv6_port))
     {
-      // Invalid address returned by PASV. Replace with address from control
-      // socket.
-      ftp_err(_("Address returned by PASV seems to be incorrect.\n"));
-      ((struct sockaddr_in*)&sa)->sin_addr = ((struct sockaddr_in*)&tmp)->sin_addr;
-    }
-
-    if (!sock_connect_addr(ftp->data, (struct sockaddr*) &sa, len))
-    {
-      ftp_trace("Could not connect to address from PASV/EPSV.\n");
-      perror("connect()");
       sock_destroy(ftp->data);
       ftp->data = NULL;
       return -1;
@@ -211,6 +320,7 @@ static int ftp_init_transfer(void)
     const struct sockaddr* local = sock_local_addr(ftp->data);
     sock_listen(ftp->data, local->sa_family);
 
+    int r = -1;
     if (local->sa_family == AF_INET)
     {
       struct sockaddr_in* tmp = (struct sockaddr_in*)local;
@@ -218,7 +328,7 @@ static int ftp_init_transfer(void)
       unsigned char* p = (unsigned char *)&tmp->sin_port;
 
       ftp_set_tmp_verbosity(vbError);
-      ftp_cmd("PORT %d,%d,%d,%d,%d,%d",
+      r = ftp_cmd_send("PORT %d,%d,%d,%d,%d,%d",
           a[0], a[1], a[2], a[3], p[0], p[1]);
     }
 #ifdef HAVE_IPV6
@@ -227,7 +337,7 @@ static int ftp_init_transfer(void)
       char* addr = printable_address(local);
 
       ftp_set_tmp_verbosity(vbError);
-      ftp_cmd("EPRT |2|%s|%u|", addr, ntohs(((struct sockaddr_in6*)local)->sin6_port));
+      r = ftp_cmd_send("EPRT |2|%s|%u|", addr, ntohs(((struct sockaddr_in6*)local)->sin6_port));
       free(addr);
     }
 #endif
@@ -239,7 +349,15 @@ static int ftp_init_transfer(void)
       return -1;
     }
 
-    if(ftp->code != ctComplete)
+    /* TYPE goes out in the same write */
+    const bool typed = (r == 0) && ftp_type_send(mode);
+    if (r == 0)
+      ftp_cmd_reply();
+    const code_t code = ftp->code;
+    if (typed)
+      ftp_type_reply(mode);
+
+    if(r != 0 || code != ctComplete)
     {
       ftp_trace("PORT/EPRT not successful\n");
       sock_destroy(ftp->data);
@@ -252,6 +370,86 @@ static int ftp_init_transfer(void)
   return 0;
 }
 
+/* if ON, the data connection for the next transfer is set up while the
+ * current one finishes, see ftp_lookahead_send()
+ */
+void ftp_lookahead(bool on)
+{
+  ftp->lookahead = on;
+}
+
+/* if ON, binary transfers are checksummed as the data passes and
+ * compared with the checksum the server computes, see
+ * ftp_verify_checksum()
+ */
+void ftp_verify(bool on)
+{
+  ftp->verify = on;
+}
+
+/* in lookahead mode, sends PASV for the next transfer once the data of
+ * the current one is in, so its reply follows the transfer's final
+ * reply without another round trip
+ * returns true if ftp_lookahead_connect() must read the reply
+ */
+static bool ftp_lookahead_send(void)
+{
+  if (!ftp->lookahead || ftp->next_data || !ftp_is_passive()
+      || !ftp->has_pasv_command)
+    return false;
+#ifdef HAVE_LIBSSH
+  if (ftp->session)
+    return false;
+#endif
+
+  int r = -1;
+  if (sock_remote_addr(ftp->ctrl)->sa_family == AF_INET)
+    r = ftp_cmd_send("PASV");
+#ifdef HAVE_IPV6
+  else
+    r = ftp_cmd_send("EPSV");
+#endif
+  if (r != 0)
+    return false;
+
+  sock_flush(ftp->ctrl);
+  return true;
+}
+
+/* reads the reply to the PASV sent by ftp_lookahead_send() and connects
+ * the data connection for the next transfer; the reply to the current
+ * transfer is kept in ftp->reply
+ */
+static void ftp_lookahead_connect(void)
+{
+  char reply[MAXREPLY+1];
+  code_t code = ftp->code;
+  int fullcode = ftp->fullcode;
+
+  strlcpy(reply, ftp->reply, sizeof(reply));
+
+  const bool ipv6 = sock_remote_addr(ftp->ctrl)->sa_family != AF_INET;
+  unsigned char pac[6] = { 0 };
+  unsigned short ipv6_port = { 0 };
+  ftp_set_tmp_verbosity(vbNone);
+  ftp_cmd_reply();
+  if (code == ctComplete && ftp_pasv_reply(ipv6, pac, &ipv6_port))
+  {
+    Socket *data = NULL;
+    if (ftp_data_create(&data) && ftp_pasv_connect(data, pac, ipv6_port))
+    {
+      sock_throughput(data);
+      ftp->next_data = data;
+    }
+    else
+      sock_destroy(data);
+  }
+
+  strlcpy(ftp->reply, reply, sizeof(ftp->reply));
+  ftp->code = code;
+  ftp->fullcode = fullcode;
+}
+
 int ftp_type(transfer_mode_t type)
 {
 #ifdef HAVE_LIBSSH
@@ -291,6 +489,9 @@ int ftp_abort(Socket* fp)
 
 	ftp_set_close_handler();
 
+	/* the transfer engines leave the data socket non-blocking */
+	sock_nonblocking(fp, false);
+
 	if (sock_check_pending(fp, false) == 1) {
 		ftp_trace("There is data on the control channel, won't send ABOR\n");
 		/* read remaining bytes from connection */
@@ -398,6 +599,80 @@ static int wait_for_output(void)
 	return 0;
 }
 
+/* returns the size of the data buffer to start a transfer with */
+static size_t data_bufsize(void)
+{
+	if(gvTransferBuffer > 0)
+		return gvTransferBuffer;
+	if(ftp->data_bufsize > FTP_BUFSIZ)
+		return ftp->data_bufsize;
+	return FTP_BUFSIZ;
+}
+
+/* in auto mode, grows the data buffer *BUF of *SIZE bytes and the kernel
+ * socket buffers to the bandwidth-delay product of the data connection,
+ * BYTES is the number of bytes transferred in the last SECS seconds
+ */
+static void data_buffer_adapt(char **buf, size_t *size, long long bytes,
+							  time_t secs)
+{
+	if(gvTransferBuffer > 0 || secs <= 0 || bytes <= 0)
+		return;
+
+	int rtt = sock_rtt(ftp->data);
+	if(rtt <= 0)
+		rtt = 100000; /* unknown, assume 100 ms */
+
+	long long bdp = bytes / secs * rtt / 1000000;
+	size_t want = *size;
+	while(want < bdp && want < FTP_MAXBUFSIZ)
+		want *= 2;
+	if(want == *size)
+		return;
+
+	ftp_trace("growing data buffer to %lu bytes (rtt %d us)\n",
+			  (unsigned long)want, rtt);
+	*buf = xrealloc(*buf, want);
+	*size = want;
+	/* the kernel buffers hold twice that, for the acks in flight */
+	sock_bufsize(ftp->data, 2 * want);
+	if(want > ftp->data_bufsize)
+		ftp->data_bufsize = want;
+}
+
+/* returns true if the I/O call that returned N failed because the
+ * non-blocking data socket wasn't ready; wait_for_input() or
+ * wait_for_output() and try again
+ */
+static bool would_block(ssize_t n)
+{
+	return n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/* writes all N bytes in BUF to the data connection OUT, waiting for
+ * the socket to drain whenever it is full
+ * returns N, or -1 on error
+ */
+static ssize_t data_write(Socket *out, const char *buf, size_t n)
+{
+	size_t left = n;
+
+	while(left > 0) {
+		ssize_t w = sock_write(out, buf, left);
+		if(would_block(w)) {
+			if(wait_for_output() != 0)
+				return -1;
+			continue;
+		}
+		if(w <= 0)
+			return -1;
+		buf += w;
+		left -= w;
+	}
+
+	return n;
+}
+
 static int maybe_abort_in(Socket* in, FILE *out)
 {
 	unsigned int i = ftp_sigints();
@@ -408,12 +683,12 @@ static int maybe_abort_in(Socket* in, FILE *out)
 	if(ftp->ti.interrupted)
 		i++;
 
-	if(i > 0 || sock_error_in(in) || ferror(out)) {
+	if(i > 0 || sock_error_in(in) || (out && ferror(out))) {
 		if(sock_error_in(in)) {
 			ftp_err(_("read error: %s\n"), strerror(errno));
 			ftp->ti.ioerror = true;
 		}
-		else if(ferror(out)) {
+		else if(out && ferror(out)) {
 			ftp_err(_("write error: %s\n"), strerror(errno));
 			ftp->ti.ioerror = true;
 		}
@@ -446,10 +721,14 @@ static int maybe_abort_out(FILE *in, Socket *out)
 	return 0;
 }
 
-static int FILE_recv_binary(Socket* in, FILE *out)
+/* receives the data connection IN to OUT, stopping after LIMIT bytes
+ * unless LIMIT is -1
+ */
+static int FILE_recv_binary(Socket* in, FILE *out, long long limit)
 {
 	time_t then = time(0) - 1;
 	time_t now;
+	long long then_size = ftp->ti.size;
 
 	ftp_set_close_handler();
 
@@ -460,14 +739,54 @@ static int FILE_recv_binary(Socket* in, FILE *out)
 	sock_clearerr_in(in);
 	clearerr(out);
 
-	char* buf = xmalloc(FTP_BUFSIZ);
-	while (!sock_eof(in)) {
-		if(wait_for_input() != 0) {
+	/* move the data straight from the socket to regular files
+	 * with splice(), if the socket supports it */
+	struct stat sb;
+	bool use_splice = !ftp->data_checksum
+		&& fstat(fileno(out), &sb) == 0 && S_ISREG(sb.st_mode)
+		&& fflush(out) == 0;
+	bool splice_failed = false;
+
+	/* with a non-blocking socket, data that has already arrived is read
+	 * at once and we only poll() when there is none */
+	bool nonblock = sock_nonblocking(in, true);
+
+	size_t bufsize = data_bufsize();
+	char* buf = xmalloc(bufsize);
+	while (!sock_eof(in) && limit != 0) {
+		if(!nonblock && wait_for_input() != 0) {
 			ftp_trace("wait_for_input() returned non-zero\n");
 			break;
 		}
 
-    const ssize_t n = sock_read(in, buf, FTP_BUFSIZ);
+		size_t want = use_splice ? FTP_SPLICE_SIZE : bufsize;
+		if(limit > 0 && (long long)want > limit)
+			want = limit;
+
+		ssize_t n;
+		if(use_splice) {
+			n = sock_splice_in(in, fileno(out), want);
+			if(n == -1 && errno == ENOSYS) {
+				ftp_trace("splice() not supported, falling back to read()\n");
+				use_splice = false;
+				continue;
+			}
+			if(n == -1 && errno == EINTR)
+				continue;
+			if(n == -1 && !would_block(n)) {
+				ftp_err(_("splice error: %s\n"), strerror(errno));
+				splice_failed = true;
+				break;
+			}
+		} else
+			n = sock_read(in, buf, want);
+		if(would_block(n)) {
+			if(wait_for_input() != 0) {
+				ftp_trace("wait_for_input() returned non-zero\n");
+				break;
+			}
+			continue;
+		}
 		if (n <= 0)
 			break;
 
@@ -476,23 +795,34 @@ static int FILE_recv_binary(Socket* in, FILE *out)
 			break;
 		}
 
-		if(fwrite(buf, sizeof(char), n, out) != n)
+		if(!use_splice && fwrite(buf, sizeof(char), n, out) != n)
 			break;
+		if(ftp->data_checksum)
+			checksum_update(ftp->data_checksum, buf, n);
 
 		ftp->ti.size += n;
+		if(limit > 0)
+			limit -= n;
 
-		if(foo_hookf) {
-			now = time(0);
-			if(now > then) {
+		now = time(0);
+		if(now > then) {
+			if(foo_hookf)
 				foo_hookf(&ftp->ti);
-				then = now;
-			}
+			data_buffer_adapt(&buf, &bufsize, ftp->ti.size - then_size,
+							  now - then);
+			then = now;
+			then_size = ftp->ti.size;
 		}
 	}
 
 	free(buf);
 	ftp_set_close_handler();
 
+	if(splice_failed) {
+		ftp->ti.finished = true;
+		ftp->ti.ioerror = true;
+		return ftp_abort(in);
+	}
 	return maybe_abort_in(in, out);
 }
 
@@ -500,6 +830,7 @@ static int FILE_send_binary(FILE *in, Socket *out)
 {
 	time_t then = time(0) - 1;
 	time_t now;
+	long long then_size = ftp->ti.size;
 
 	ftp_set_close_handler();
 
@@ -510,27 +841,101 @@ static int FILE_send_binary(FILE *in, Socket *out)
 	clearerr(in);
 	sock_clearerr_out(out);
 
-	char* buf = xmalloc(FTP_BUFSIZ);
+	/* send regular files with sendfile(), starting where IN is
+	 * positioned (the restart offset), if the socket supports it and
+	 * we don't need to see the data for a checksum */
+	struct stat sb;
+	off_t offset = -1;
+	bool use_sendfile = !ftp->data_checksum
+		&& fstat(fileno(in), &sb) == 0 && S_ISREG(sb.st_mode)
+		&& (offset = ftello(in)) != -1;
+	bool sendfile_failed = false;
+
+	bool nonblock = sock_nonblocking(out, true);
+
+	size_t bufsize = data_bufsize();
+	char* buf = xmalloc(bufsize);
+	while(use_sendfile) {
+		if(ftp_sigints() > 0)
+			break;
+
+		if(!nonblock && wait_for_output() != 0)
+			break;
+
+		ssize_t n = sock_sendfile_out(out, fileno(in), &offset,
+									  FTP_SENDFILE_SIZE);
+		if(would_block(n)) {
+			if(wait_for_output() != 0)
+				break;
+			continue;
+		}
+		if(n == -1 && errno == ENOSYS) {
+			ftp_trace("sendfile() not supported, falling back to write()\n");
+			use_sendfile = false;
+			/* let fread() continue where sendfile() stopped */
+			if(fseeko(in, offset, SEEK_SET) != 0) {
+				ftp_err(_("read error: %s\n"), strerror(errno));
+				sendfile_failed = true;
+			}
+			break;
+		}
+		if(n == -1 && errno == EINTR)
+			continue;
+		if(n == -1) {
+			ftp_err(_("sendfile error: %s\n"), strerror(errno));
+			sendfile_failed = true;
+			break;
+		}
+		if(n == 0)
+			break;
+
+		ftp->ti.size += n;
+		now = time(0);
+		if(now > then) {
+			if(foo_hookf)
+				foo_hookf(&ftp->ti);
+			data_buffer_adapt(&buf, &bufsize, ftp->ti.size - then_size,
+							  now - then);
+			then = now;
+			then_size = ftp->ti.size;
+		}
+	}
+
+	if(sendfile_failed || use_sendfile)
+		free(buf);
+	if(sendfile_failed) {
+		ftp_set_close_handler();
+		ftp->ti.finished = true;
+		ftp->ti.ioerror = true;
+		return ftp_abort(out);
+	}
+	if(use_sendfile)
+		return maybe_abort_out(in, out);
+
 	while(!feof(in)) {
-		ssize_t n = fread(buf, sizeof(char), FTP_BUFSIZ, in);
+		ssize_t n = fread(buf, sizeof(char), bufsize, in);
 		if(n <= 0)
 			break;
 
 		if(ftp_sigints() > 0)
 			break;
 
-		if(wait_for_output() != 0)
+		if(!nonblock && wait_for_output() != 0)
 			break;
 
-    if (sock_write(out, buf, n) != n)
-      break;
+		if(data_write(out, buf, n) != n)
+			break;
+		if(ftp->data_checksum)
+			checksum_update(ftp->data_checksum, buf, n);
 		ftp->ti.size += n;
-		if(foo_hookf) {
-			now = time(0);
-			if(now > then) {
+		now = time(0);
+		if(now > then) {
+			if(foo_hookf)
 				foo_hookf(&ftp->ti);
-				then = now;
-			}
+			data_buffer_adapt(&buf, &bufsize, ftp->ti.size - then_size,
+							  now - then);
+			then = now;
+			then_size = ftp->ti.size;
 		}
 	}
 	sock_flush(out);
@@ -539,7 +944,67 @@ static int FILE_send_binary(FILE *in, Socket *out)
 	return maybe_abort_out(in, out);
 }
 
-static int FILE_recv_ascii(Socket* in, FILE *out)
+/* copies N bytes from SRC to DST, counting the '\n' characters in
+ * *BARELFS (the caller skips the '\n' of every "\r\n" pair)
+ */
+static size_t copy_count_lfs(char *dst, const char *src, size_t n,
+							 unsigned *barelfs)
+{
+	const char *p = src, *e = src + n;
+
+	while((p = memchr(p, '\n', e - p)) != 0) {
+		(*barelfs)++;
+		p++;
+	}
+	memcpy(dst, src, n);
+	return n;
+}
+
+/* translates the N bytes in SRC from network ASCII into DST, turning
+ * "\r\n" into "\n"; DST must hold at least N+1 bytes
+ * a '\r' at the end of SRC is kept in *PENDING_CR until the next block
+ * returns the number of bytes stored in DST
+ */
+static size_t ascii_crlf_to_lf(char *dst, const char *src, size_t n,
+							   bool *pending_cr, unsigned *barelfs)
+{
+	const char *p = src, *e = src + n;
+	char *d = dst;
+
+	if(*pending_cr && n > 0) {
+		*pending_cr = false;
+		if(*p == '\n')
+			p++;
+		*d++ = (p == src) ? '\r' : '\n';
+	}
+
+	while(p < e) {
+		const char *cr = memchr(p, '\r', e - p);
+		if(!cr) {
+			d += copy_count_lfs(d, p, e - p, barelfs);
+			break;
+		}
+		d += copy_count_lfs(d, p, cr - p, barelfs);
+		if(cr + 1 == e) {
+			*pending_cr = true;
+			break;
+		}
+		if(cr[1] == '\n') {
+			*d++ = '\n';
+			p = cr + 2;
+		} else {
+			*d++ = '\r';
+			p = cr + 1;
+		}
+	}
+
+	return d - dst;
+}
+
+/* receives ASCII data from IN and passes it to FUNC, with local line
+ * endings, as it arrives; stops early if FUNC returns non-zero
+ */
+static void recv_ascii(Socket* in, ftp_data_func func, void *arg)
 {
 	time_t then = time(0) - 1;
 	time_t now;
@@ -551,44 +1016,42 @@ static int FILE_recv_ascii(Socket* in, FILE *out)
 	ftp->ti.begin = false;
 
 	sock_clearerr_in(in);
-	clearerr(out);
 
-  bool next = true;
-  int nc = 0;
-	while (true)
-  {
-    int c = 0;
-    if (next)
-    {
-      c = sock_get(in);
-      if (c == EOF)
-        break;
-    }
-    else
-    {
-      c = nc;
-      next = true;
-    }
-
-		if (ftp_sigints() > 0 || wait_for_input() != 0)
+	/* a '\r' at the end of a block, a trailing one is dropped */
+	bool pending_cr = false;
+	bool nonblock = sock_nonblocking(in, true);
+	size_t bufsize = data_bufsize();
+	char* buf = xmalloc(bufsize);
+	char* tbuf = xmalloc(bufsize + 1);
+	while (!sock_eof(in)) {
+		if(!nonblock && wait_for_input() != 0) {
+			ftp_trace("wait_for_input() returned non-zero\n");
 			break;
+		}
 
-		if (c == '\n')
-			ftp->ti.barelfs++;
-		else if (c == '\r')
-    {
-			nc = sock_get(in);
-			if (nc == EOF)
+		ssize_t n = sock_read(in, buf, bufsize);
+		if(would_block(n)) {
+			if(wait_for_input() != 0) {
+				ftp_trace("wait_for_input() returned non-zero\n");
 				break;
-			if (nc != '\n')
-        next = false;
-      else
-        c = nc;
+			}
+			continue;
 		}
-		if (fputc(c, out) == EOF)
+		if (n <= 0)
 			break;
 
-		ftp->ti.size++;
+		if(ftp_sigints() > 0) {
+			ftp_trace("break due to sigint\n");
+			break;
+		}
+
+		size_t tn = ascii_crlf_to_lf(tbuf, buf, n, &pending_cr,
+									 &ftp->ti.barelfs);
+		if(func(tbuf, tn, arg) != 0)
+			break;
+
+		ftp->ti.size += tn;
+
 		if(foo_hookf) {
 			now = time(0);
 			if(now > then) {
@@ -598,9 +1061,53 @@ static int FILE_recv_ascii(Socket* in, FILE *out)
 		}
 	}
 
+	free(buf);
+	free(tbuf);
+}
+
+static int FILE_write_data(char *data, size_t n, void *out)
+{
+	return fwrite(data, sizeof(char), n, (FILE *)out) == n ? 0 : -1;
+}
+
+static int FILE_recv_ascii(Socket* in, FILE *out)
+{
+	clearerr(out);
+	recv_ascii(in, FILE_write_data, out);
 	return maybe_abort_in(in, out);
 }
 
+static int func_recv_ascii(Socket* in, ftp_data_func func, void *arg)
+{
+	recv_ascii(in, func, arg);
+	return maybe_abort_in(in, 0);
+}
+
+/* translates the N bytes in SRC into network ASCII in DST, turning
+ * every "\n" into "\r\n"; DST must hold at least 2*N bytes
+ * returns the number of bytes stored in DST
+ */
+static size_t ascii_lf_to_crlf(char *dst, const char *src, size_t n)
+{
+	const char *p = src, *e = src + n;
+	char *d = dst;
+
+	while(p < e) {
+		const char *lf = memchr(p, '\n', e - p);
+		size_t len = (lf ? lf : e) - p;
+
+		memcpy(d, p, len);
+		d += len;
+		if(!lf)
+			break;
+		*d++ = '\r';
+		*d++ = '\n';
+		p = lf + 1;
+	}
+
+	return d - dst;
+}
+
 static int FILE_send_ascii(FILE* in, Socket* out)
 {
 	time_t then = time(0) - 1;
@@ -615,22 +1122,25 @@ static int FILE_send_ascii(FILE* in, Socket* out)
 	clearerr(in);
 	sock_clearerr_out(out);
 
-  int c;
-	while((c = fgetc(in)) != EOF) {
+	bool nonblock = sock_nonblocking(out, true);
+	size_t bufsize = data_bufsize();
+	char* buf = xmalloc(bufsize);
+	char* tbuf = xmalloc(2 * bufsize);
+	while(!feof(in)) {
+		size_t n = fread(buf, sizeof(char), bufsize, in);
+		if(n == 0)
+			break;
+
 		if(ftp_sigints() > 0)
 			break;
 
-		if(wait_for_output() != 0)
+		if(!nonblock && wait_for_output() != 0)
 			break;
 
-		if(c == '\n') {
-			if(sock_put(out, '\r') == EOF)
-				break;
-			ftp->ti.size++;
-		}
-		if(sock_put(out, c) == EOF)
+		ssize_t tn = ascii_lf_to_crlf(tbuf, buf, n);
+		if(data_write(out, tbuf, tn) != tn)
 			break;
-		ftp->ti.size++;
+		ftp->ti.size += tn;
 		if(foo_hookf) {
 			now = time(0);
 			if(now > then) {
@@ -639,6 +1149,8 @@ static int FILE_send_ascii(FILE* in, Socket* out)
 			}
 		}
 	}
+	free(buf);
+	free(tbuf);
 
 	return maybe_abort_out(in, out);
 }
@@ -654,6 +1166,7 @@ void reset_transfer_info(void)
 	ftp->ti.finished = false;
 	ftp->ti.stalled = 0;
 	ftp->ti.begin = true;
+	ftp->ti.checksum_mismatch = false;
 	gettimeofday(&ftp->ti.start_time, 0);
 	if(!ftp->ti.local_name)
 		ftp->ti.local_name = xstrdup("local");
@@ -661,15 +1174,13 @@ void reset_transfer_info(void)
 		ftp->ti.remote_name = xstrdup("remote");
 }
 
-int ftp_list(const char *cmd, const char *param, FILE *fp)
+/* sends the listing command CMD and receives the listing to FP, or
+ * passes it to FUNC as it arrives if FP is 0
+ */
+static int do_list(const char *cmd, const char *param, FILE *fp,
+                   ftp_data_func func, void *arg)
 {
-  if (!cmd || !fp || !ftp_connected())
-    return -1;
-
-#ifdef HAVE_LIBSSH
-  if (ftp->session)
-    return ssh_list(cmd, param, fp);
-#endif
+  int r;
 
   reset_transfer_info();
   foo_hookf = NULL;
@@ -678,7 +1189,7 @@ int ftp_list(const char *cmd, const char *param, FILE *fp)
   ftp_type(tmAscii);
 #endif
 
-  if (ftp_init_transfer() != 0) {
+  if (ftp_init_transfer(tmCurrent) != 0) {
     ftp_err(_("transfer initialization failed"));
     return -1;
   }
@@ -696,17 +1207,54 @@ int ftp_list(const char *cmd, const char *param, FILE *fp)
     return -1;
   }
 
-  if (FILE_recv_ascii(ftp->data, fp) != 0)
+  if (fp)
+    r = FILE_recv_ascii(ftp->data, fp);
+  else
+    r = func_recv_ascii(ftp->data, func, arg);
+  if (r != 0)
     return -1;
 
   sock_destroy(ftp->data);
   ftp->data = NULL;
 
+  const bool ahead = ftp_lookahead_send();
   ftp_read_reply();
+  if (ahead)
+    ftp_lookahead_connect();
 
   return ftp->code == ctComplete ? 0 : -1;
 }
 
+int ftp_list(const char *cmd, const char *param, FILE *fp)
+{
+  if (!cmd || !fp || !ftp_connected())
+    return -1;
+
+#ifdef HAVE_LIBSSH
+  if (ftp->session)
+    return ssh_list(cmd, param, fp);
+#endif
+
+  return do_list(cmd, param, fp, 0, 0);
+}
+
+/* like ftp_list(), but the listing is passed to FUNC as it arrives,
+ * instead of being written to a file
+ */
+int ftp_list_func(const char *cmd, const char *param,
+                  ftp_data_func func, void *arg)
+{
+  if (!cmd || !func || !ftp_connected())
+    return -1;
+
+#ifdef HAVE_LIBSSH
+  if (ftp->session)
+    return -1;
+#endif
+
+  return do_list(cmd, param, 0, func, arg);
+}
+
 void transfer_finished(void)
 {
 	ftp->ti.finished = true;
@@ -714,6 +1262,33 @@ void transfer_finished(void)
 		foo_hookf(&ftp->ti);
 }
 
+/* reads the reply to a transfer command that was pipelined after a
+ * REST that failed, and drops the transfer if the server started it
+ * anyway; the reply to REST is kept in ftp->reply
+ */
+static void ftp_cancel_transfer(void)
+{
+	char reply[MAXREPLY+1];
+	code_t code = ftp->code;
+	int fullcode = ftp->fullcode;
+
+	strlcpy(reply, ftp->reply, sizeof(reply));
+
+	ftp_set_tmp_verbosity(vbNone);
+	ftp_cmd_reply();
+	if(ftp->code == ctPrelim) {
+		ftp_trace("transfer started without REST, dropping it\n");
+		sock_destroy(ftp->data);
+		ftp->data = 0;
+		ftp_set_tmp_verbosity(vbNone);
+		ftp_read_reply();
+	}
+
+	strlcpy(ftp->reply, reply, sizeof(ftp->reply));
+	ftp->code = code;
+	ftp->fullcode = fullcode;
+}
+
 static int ftp_init_receive(const char *path, transfer_mode_t mode,
 							ftp_transfer_func hookf)
 {
@@ -725,21 +1300,29 @@ static int ftp_init_receive(const char *path, transfer_mode_t mode,
 	foo_hookf = hookf;
 	reset_transfer_info();
 
-	if(ftp_init_transfer() != 0)
+	if(ftp_init_transfer(mode) != 0)
 		return -1;
 
-	ftp_type(mode);
+	/* REST and RETR go out in one write */
+	if(rp > 0 && ftp_cmd_send("REST %ld", rp) != 0)
+		return -1;
+	if(ftp_cmd_send("RETR %s", path) != 0) {
+		ftp_cmd_unwind();
+		return -1;
+	}
 
 	if(rp > 0) {
 		/* fp is assumed to be fseek'd already */
-		ftp_cmd("REST %ld", rp);
-		if(ftp->code != ctContinue)
+		ftp_cmd_reply();
+		if(ftp->code != ctContinue) {
+			ftp_cancel_transfer();
 			return -1;
+		}
 		ftp->ti.size = rp;
 		ftp->ti.restart_size = rp;
 	}
 
-	ftp_cmd("RETR %s", path);
+	ftp_cmd_reply();
 	if(ftp->code != ctPrelim)
 		return -1;
 
@@ -778,7 +1361,7 @@ static int ftp_do_receive(FILE *fp,
 	int r;
 
 	if(mode == tmBinary)
-		r = FILE_recv_binary(ftp->data, fp);
+		r = FILE_recv_binary(ftp->data, fp, -1);
 	else
 		r = FILE_recv_ascii(ftp->data, fp);
 
@@ -786,8 +1369,11 @@ static int ftp_do_receive(FILE *fp,
 	ftp->data = 0;
 
 	if(r == 0) {
+		const bool ahead = ftp_lookahead_send();
 		transfer_finished();
 		ftp_read_reply();
+		if(ahead)
+			ftp_lookahead_connect();
 		ftp->ti.ioerror = (ftp->code != ctComplete);
 		if(ftp->code != ctComplete) {
 			ftp_trace("transfer failed\n");
@@ -826,35 +1412,44 @@ static int ftp_send(const char *path, FILE *fp, putmode_t how,
 	reset_transfer_info();
 	ftp->ti.transfer_is_put = true;
 
-	if(ftp_init_transfer() != 0)
+	if(ftp_init_transfer(mode) != 0)
 		return -1;
 
-	ftp_type(mode);
-
+	/* unlike RETR, a store command must wait for the reply to REST, a
+	 * server that refused REST would overwrite the file from the start */
 	if(rp > 0) {
 		/* fp is assumed to be fseek'd already */
 		ftp_cmd("REST %ld", rp);
-		if(ftp->code != ctContinue)
+		if(ftp->code != ctContinue) {
+			sock_destroy(ftp->data);
+			ftp->data = 0;
 			return -1;
+		}
 		ftp->ti.size = rp;
 		ftp->ti.restart_size = rp;
 	}
 
-	ftp_set_tmp_verbosity(vbError);
 	switch(how) {
 	  case putUnique:
-		ftp_cmd("STOU %s", path);
-		if(ftp->fullcode == 502)
-			ftp->has_stou_command = false;
+		r = ftp_cmd_send("STOU %s", path);
 		break;
 	  case putAppend:
-		ftp_cmd("APPE %s", path);
+		r = ftp_cmd_send("APPE %s", path);
 		break;
 	  case putNormal:
 	  default:
-		ftp_cmd("STOR %s", path);
+		r = ftp_cmd_send("STOR %s", path);
 		break;
 	}
+	if(r != 0) {
+		ftp_cmd_unwind();
+		return -1;
+	}
+
+	ftp_set_tmp_verbosity(vbError);
+	ftp_cmd_reply();
+	if(how == putUnique && ftp->fullcode == 502)
+		ftp->has_stou_command = false;
 
 	if(ftp->code != ctPrelim)
 		return -1;
@@ -894,8 +1489,11 @@ static int ftp_send(const char *path, FILE *fp, putmode_t how,
 	ftp->data = 0;
 
 	if(r == 0) {
+		const bool ahead = ftp_lookahead_send();
 		transfer_finished();
 		ftp_read_reply();
+		if(ahead)
+			ftp_lookahead_connect();
 		ftp->ti.ioerror = (ftp->code != ctComplete);
 		if(ftp->code != ctComplete) {
 			ftp_trace("transfer failed\n");
@@ -938,9 +1536,8 @@ int ftp_fxpfile(Ftp *srcftp, const char *srcfile,
 
 	/* setup source side */
 	ftp_use(srcftp);
-	ftp_type(mode);
   // TODO: IPv6 support
-	if(!ftp_pasv(false, addr, NULL)) {
+	if(!ftp_pasv(false, mode, addr, NULL)) {
 		ftp_use(thisftp);
 		return -1;
 	}
@@ -966,7 +1563,7 @@ int ftp_fxpfile(Ftp *srcftp, const char *srcfile,
 		if(f && f->size != (unsigned long long)-1)
 			ftp->restart_offset = f->size;
 		else {
-			ftp->restart_offset = ftp_filesize(destfile);
+			ftp->restart_offset = ftp_filesize(destfile, false);
 			if(ftp->restart_offset == (unsigned long long)-1) {
 				ftp_err(_("unable to get remote filesize of '%s',"
 						  " unable to resume\n"),
@@ -1046,6 +1643,71 @@ int ftp_fxpfile(Ftp *srcftp, const char *srcfile,
 	return r;
 }
 
+/* adds the first LEN bytes of the local file PATH to CS, for the part
+ * of a file that a resumed transfer doesn't transfer
+ * returns 0 on success or -1 on error
+ */
+static int checksum_file(checksum *cs, const char *path, off_t len)
+{
+	char buf[FTP_SPLICE_SIZE];
+	ssize_t n = 0;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd == -1) {
+		ftp_err("%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	while(len > 0) {
+		n = read(fd, buf, min(len, (off_t)sizeof(buf)));
+		if(n <= 0)
+			break;
+		checksum_update(cs, buf, n);
+		len -= n;
+	}
+	if(n == -1)
+		ftp_err("%s: %s\n", path, strerror(errno));
+	close(fd);
+	return len > 0 ? -1 : 0;
+}
+
+/* compares the checksum CS of the data transferred with the checksum
+ * the server computes of the remote file PATH
+ * returns 0 if they match, else -1 and ftp->ti.checksum_mismatch is set
+ * if they differ
+ */
+static int ftp_verify_checksum(const char *path, checksum *cs)
+{
+	char local[CHECKSUM_HEXLEN + 1];
+	char *remote;
+	bool match;
+
+	checksum_final(cs, local);
+	remote = ftp_checksum(path, cs->type);
+	if(!remote) {
+		ftp_err(_("%s: unable to verify %s checksum\n"),
+				path, checksum_name(cs->type));
+		return -1;
+	}
+
+	/* XCRC may leave out leading zeros */
+	if(cs->type == csCRC32)
+		match = strtoul(local, 0, 16) == strtoul(remote, 0, 16);
+	else
+		match = strcasecmp(local, remote) == 0;
+	ftp_trace("%s checksum of %s: local %s, remote %s\n",
+			  checksum_name(cs->type), path, local, remote);
+	free(remote);
+
+	if(!match) {
+		ftp_err(_("%s: %s checksum mismatch\n"), path,
+				checksum_name(cs->type));
+		ftp->ti.checksum_mismatch = true;
+		return -1;
+	}
+	return 0;
+}
+
 int ftp_getfile(const char *infile, const char *outfile, getmode_t how,
 				transfer_mode_t mode, ftp_transfer_func hookf)
 {
@@ -1054,6 +1716,8 @@ int ftp_getfile(const char *infile, const char *outfile, getmode_t how,
 	struct stat statbuf;
 	long rp = 0;
 	int (*close_func)(FILE *fp);
+	checksum cs;
+	bool verify = false;
 
 	if(stat(outfile, &statbuf) == 0) {
 		if(S_ISDIR(statbuf.st_mode)) {
@@ -1074,6 +1738,16 @@ int ftp_getfile(const char *infile, const char *outfile, getmode_t how,
 	/* we need to save this, because ftp_init_receive() sets it to zero */
 	rp = ftp->restart_offset;
 
+	if(ftp->verify && mode == tmBinary) {
+		checksum_init(&cs, ftp_checksum_type());
+		verify = (cs.type != csNone);
+		/* the checksum is of the whole remote file */
+		if(verify && rp > 0L && checksum_file(&cs, outfile, rp) != 0) {
+			ftp->restart_offset = 0L;
+			return -1;
+		}
+	}
+
 	reset_transfer_info();
 #ifdef HAVE_LIBSSH
 	if (ftp->session)
@@ -1129,13 +1803,304 @@ int ftp_getfile(const char *infile, const char *outfile, getmode_t how,
 
 	foo_hookf = hookf;
 
+	ftp->data_checksum = verify ? &cs : 0;
 #ifdef HAVE_LIBSSH
 	if(ftp->session)
 		r = ssh_do_receive(infile, fp, mode, hookf);
 	else
 #endif
 		r = ftp_do_receive(fp, mode, hookf);
+	ftp->data_checksum = 0;
 	close_func(fp);
+
+	if(r == 0 && verify)
+		r = ftp_verify_checksum(infile, &cs);
+	return r;
+}
+
+/* progress of a segment worker, sent to the parent as it arrives */
+typedef struct segment_progress
+{
+	unsigned int segment;
+	ssize_t received;
+} segment_progress;
+
+static int seg_progressfd = -1;
+static unsigned int seg_index;
+static long long seg_reported;   /* offset reported so far */
+
+/* transfer hook of a segment worker, passes the bytes received since
+ * the last call on to the parent
+ */
+static void seg_report(transfer_info *ti)
+{
+	segment_progress p;
+
+	p.segment = seg_index;
+	p.received = ti->size - seg_reported;
+	if(p.received <= 0)
+		return;
+	if(write(seg_progressfd, &p, sizeof(p)) != sizeof(p))
+		/* the parent has gone away */
+		ftp_trace("failed to report progress\n");
+	seg_reported = ti->size;
+}
+
+/* receives bytes START up to END of PATH in binary mode to the same
+ * offset in OUTFILE; END == -1 means up to end of file
+ * the transfer is cut short once END is reached
+ * the bytes received are reported on PROGRESSFD as part of SEGMENT
+ * once they are written
+ * returns 0 on success, else -1
+ */
+static int ftp_receive_range(const char *path, const char *outfile,
+							 unsigned int segment, off_t start, off_t end,
+							 int progressfd)
+{
+	FILE *fp;
+	int fd, r;
+
+	/* an own file offset, the one of the parent is shared by all workers */
+	fd = open(outfile, O_WRONLY);
+	if(fd == -1 || (fp = fdopen(fd, "w")) == 0) {
+		ftp_err("%s: %s\n", outfile, strerror(errno));
+		if(fd != -1)
+			close(fd);
+		return -1;
+	}
+	/* what has been reported must be on disk, it is kept if we fail */
+	setvbuf(fp, 0, _IONBF, 0);
+	if(fseeko(fp, start, SEEK_SET) != 0) {
+		ftp_err("%s: %s\n", outfile, strerror(errno));
+		fclose(fp);
+		return -1;
+	}
+
+	seg_progressfd = progressfd;
+	seg_index = segment;
+	seg_reported = start;
+
+	ftp->restart_offset = start;
+	if(ftp_init_receive(path, tmBinary, seg_report) != 0) {
+		fclose(fp);
+		return -1;
+	}
+
+	r = FILE_recv_binary(ftp->data, fp, end == -1 ? -1 : end - start);
+	seg_report(&ftp->ti);
+
+	/* closing the data connection before the end of the file makes the
+	 * server answer the RETR with an error, so there is no need for ABOR
+	 */
+	sock_destroy(ftp->data);
+	ftp->data = 0;
+	if(r != 0 || ftp->ti.interrupted) {
+		fclose(fp);
+		return -1;
+	}
+
+	ftp_set_tmp_verbosity(vbNone);
+	ftp_read_reply();
+	if(end != -1) {
+		fclose(fp);
+		return ftp->ti.size == end ? 0 : -1;
+	}
+	if(ftp->code != ctComplete) {
+		fclose(fp);
+		return -1;
+	}
+	/* the file was preallocated to the size it had, it may have shrunk */
+	r = ftruncate(fileno(fp), ftp->ti.size);
+	if(r != 0)
+		ftp_err("%s: %s\n", outfile, strerror(errno));
+	fclose(fp);
+	return r == 0 ? 0 : -1;
+}
+
+/* gets INFILE into OUTFILE in binary mode over SEGMENTS connections
+ * from the connection pool at once, each connection RESTarts at the
+ * beginning of its part of the file
+ * falls back to a normal ftp_getfile() if the size of INFILE is unknown,
+ * the server doesn't support REST or no extra connections can be opened
+ * returns 0 on success, else -1
+ */
+int ftp_getfile_segmented(const char *infile, const char *outfile,
+						  unsigned int segments, ftp_transfer_func hookf)
+{
+	unsigned long long size;
+	list *conns = 0;
+	listitem *li;
+	pid_t *pids;
+	bool *done;
+	off_t seglen, *received;
+	segment_progress p;
+	int fd, progressfds[2];
+	unsigned int i, n, nworkers = 0;
+	time_t then = time(0) - 1;
+	int r = 0;
+
+#ifdef HAVE_LIBSSH
+	if(ftp->session)
+		return ftp_getfile(infile, outfile, getNormal, tmBinary, hookf);
+#endif
+
+	/* the file is preallocated to this size, a cached one may be old */
+	size = ftp_filesize(infile, true);
+	if(segments < 2 || size == (unsigned long long)-1
+	   || size / segments < FTP_BUFSIZ)
+		return ftp_getfile(infile, outfile, getNormal, tmBinary, hookf);
+
+	/* RFC 3659 allows REST 0 to check if the server supports REST STREAM,
+	 * once per connection is enough */
+	if(ftp->has_rest_command && !ftp->rest_checked) {
+		ftp_set_tmp_verbosity(vbNone);
+		ftp_cmd("REST 0");
+		if(ftp->code != ctContinue)
+			ftp->has_rest_command = false;
+		ftp->rest_checked = true;
+	}
+	if(!ftp->has_rest_command) {
+		ftp_trace("server doesn't support REST, not segmenting\n");
+		return ftp_getfile(infile, outfile, getNormal, tmBinary, hookf);
+	}
+
+	conns = ftp_pool_acquire(segments);
+	n = list_numitem(conns);
+	if(n < 2) {
+		list_free(conns);
+		return ftp_getfile(infile, outfile, getNormal, tmBinary, hookf);
+	}
+
+	fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(fd == -1) {
+		ftp_err("%s: %s\n", outfile, strerror(errno));
+		list_free(conns);
+		return -1;
+	}
+	/* preallocate, so the segments don't fragment the file */
+#ifdef HAVE_POSIX_FALLOCATE
+	if(posix_fallocate(fd, 0, size) != 0)
+#endif
+	if(ftruncate(fd, size) != 0) {
+		ftp_err("%s: %s\n", outfile, strerror(errno));
+		close(fd);
+		list_free(conns);
+		return -1;
+	}
+
+	if(pipe(progressfds) != 0) {
+		perror("pipe()");
+		close(fd);
+		list_free(conns);
+		return -1;
+	}
+
+	reset_transfer_info();
+	free(ftp->ti.remote_name);
+	free(ftp->ti.local_name);
+	ftp->ti.remote_name = xstrdup(infile);
+	ftp->ti.local_name = xstrdup(outfile);
+	ftp->ti.total_size = size;
+	foo_hookf = hookf;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	seglen = size / n;
+	pids = (pid_t *)xmalloc(n * sizeof(pid_t));
+	done = (bool *)xmalloc(n * sizeof(bool));
+	received = (off_t *)xmalloc(n * sizeof(off_t));
+	for(i = 0; i < n; i++) {
+		done[i] = false;
+		received[i] = 0;
+	}
+	for(i=0, li=conns->first; li; i++, li=li->next) {
+		pid_t pid = fork();
+		if(pid == 0) {
+			close(progressfds[0]);
+			close(fd);
+			ftp_use((Ftp *)li->data);
+			r = ftp_receive_range(infile, outfile, i, i * seglen,
+								  i + 1 == n ? -1 : (i + 1) * seglen,
+								  progressfds[1]);
+			_exit(r == 0 ? 0 : 1);
+		}
+		if(pid == -1) {
+			perror("fork()");
+			r = -1;
+			break;
+		}
+		pids[nworkers++] = pid;
+	}
+	close(progressfds[1]);
+
+	if(foo_hookf)
+		foo_hookf(&ftp->ti);
+	ftp->ti.begin = false;
+
+	/* show the progress of all segments as one transfer */
+	while(read(progressfds[0], &p, sizeof(p)) == sizeof(p)) {
+		if(p.segment < n)
+			received[p.segment] += p.received;
+		ftp->ti.size += p.received;
+		if(foo_hookf) {
+			time_t now = time(0);
+			if(now > then) {
+				foo_hookf(&ftp->ti);
+				then = now;
+			}
+		}
+	}
+	close(progressfds[0]);
+
+	for(i=0; i < nworkers; i++) {
+		int status;
+		if(waitpid(pids[i], &status, 0) == -1
+		   || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			r = -1;
+		else
+			done[i] = true;
+	}
+
+	/* the file was preallocated, keep only the part that is known to
+	 * have arrived, so a later --resume continues from there */
+	if(r != 0) {
+		off_t complete;
+
+		for(i = 0; i < n && done[i]; i++)
+			;
+		if(i == n)
+			i--;
+		complete = i * seglen + received[i];
+		ftp_trace("keeping the first %lld bytes of %s\n",
+				  (long long)complete, outfile);
+		if(ftruncate(fd, complete) != 0)
+			ftp_err("%s: %s\n", outfile, strerror(errno));
+	}
+
+	free(received);
+	free(done);
+	free(pids);
+	list_free(conns);
+	close(fd);
+
+	if(r != 0)
+		ftp->ti.ioerror = true;
+	transfer_finished();
+
+	/* the segments arrive out of order, so the file is checksummed
+	 * once it's complete, while it's still in the page cache */
+	if(r == 0 && ftp->verify) {
+		checksum cs;
+
+		checksum_init(&cs, ftp_checksum_type());
+		if(cs.type != csNone) {
+			r = checksum_file(&cs, outfile, size);
+			if(r == 0)
+				r = ftp_verify_checksum(infile, &cs);
+		}
+	}
+
 	return r;
 }
 
@@ -1145,6 +2110,8 @@ int ftp_putfile(const char *infile, const char *outfile, putmode_t how,
 	FILE *fp;
 	int r;
 	struct stat statbuf;
+	checksum cs;
+	bool verify = false;
 
 	if(stat(infile, &statbuf) != 0) {
 		perror(infile);
@@ -1175,7 +2142,7 @@ int ftp_putfile(const char *infile, const char *outfile, putmode_t how,
 		if(f && f->size != (unsigned long long)-1)
 			ftp->restart_offset = f->size;
 		else {
-			ftp->restart_offset = ftp_filesize(outfile);
+			ftp->restart_offset = ftp_filesize(outfile, false);
 			if(ftp->restart_offset == (unsigned long long)-1) {
 				ftp_err(_("unable to get remote filesize of '%s',"
 						  " unable to resume\n"),
@@ -1186,6 +2153,18 @@ int ftp_putfile(const char *infile, const char *outfile, putmode_t how,
 	} else
 		ftp->restart_offset = 0L;
 
+	/* an appended file can't be compared with what we sent */
+	if(ftp->verify && mode == tmBinary && how != putAppend) {
+		checksum_init(&cs, ftp_checksum_type());
+		verify = (cs.type != csNone);
+		if(verify && ftp->restart_offset > 0L
+		   && checksum_file(&cs, infile, ftp->restart_offset) != 0)
+		{
+			fclose(fp);
+			ftp->restart_offset = 0L;
+			return -1;
+		}
+	}
 
 	if(ftp->restart_offset > 0L) {
 		if(fseek(fp, ftp->restart_offset, SEEK_SET) != 0) {
@@ -1198,12 +2177,19 @@ int ftp_putfile(const char *infile, const char *outfile, putmode_t how,
 
 	foo_hookf = hookf;
 
+	ftp->data_checksum = verify ? &cs : 0;
 #ifdef HAVE_LIBSSH
 	if(ftp->session)
 		r = ssh_send(outfile, fp, how, mode, hookf);
 	else
 #endif
 		r = ftp_send(outfile, fp, how, mode, hookf);
+	ftp->data_checksum = 0;
 	fclose(fp);
+
+	/* ftp_send() parses the name STOU stored the file as into local_name */
+	if(r == 0 && verify && !ftp->ti.interrupted && !ftp->ti.ioerror)
+		r = ftp_verify_checksum(how == putUnique ? ftp->ti.local_name
+								: outfile, &cs);
 	return r;
 }
@@ -17,9 +17,12 @@
 #include "strq.h"
 #include "lscolors.h"
 
-typedef struct {
+typedef struct lscolor {
   char *msk;
-  char *clr;
+  char *clr;               /* complete escape sequence, lc + color + rc */
+  const char *suffix;      /* for "*SUFFIX" masks, points into msk */
+  size_t suffixlen;
+  struct lscolor *next;    /* next in the same extension bucket */
 } lscolor;
 
 static bool colors_initialized = false;
@@ -32,11 +35,92 @@ static char *lc = NULL, *rc = NULL, *ec = NULL;
 
 static lscolor *clrs = NULL;
 
+/* "*SUFFIX" masks by the extension of SUFFIX, each bucket in the
+ * order of LS_COLORS; the other masks are tried with fnmatch() */
+static lscolor **ext_buckets = NULL;
+static unsigned int ext_nbuckets = 0;
+static lscolor **patterns = NULL;
+static int number_of_patterns = 0;
+
 char *endcolor(void)
 {
   return ec;
 }
 
+static unsigned int ext_hash(const char *ext)
+{
+  unsigned int h = 2166136261U;   /* FNV-1a */
+
+  while(*ext) {
+    h ^= (unsigned char)*ext++;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+/* returns the suffix of a "*SUFFIX" mask, if SUFFIX contains a dot and
+ * no other wildcard, or 0
+ */
+static const char *mask_suffix(const char *msk)
+{
+  if(msk[0] != '*' || !strchr(msk + 1, '.') || strpbrk(msk + 1, "*?[\\"))
+    return 0;
+  return msk + 1;
+}
+
+/* replaces CLR with the complete escape sequence to print it */
+static char *render_color(char *clr)
+{
+  const size_t len = strlen(lc) + strlen(clr) + strlen(rc) + 1;
+  char *r = xmalloc(len);
+
+  snprintf(r, len, "%s%s%s", lc, clr, rc);
+  free(clr);
+  return r;
+}
+
+/* renders the colors and sorts the masks into the extension hash and
+ * the pattern list
+ */
+static void compile_colors(void)
+{
+  int i;
+
+  diclr = render_color(diclr);
+  lnclr = render_color(lnclr);
+  ficlr = render_color(ficlr);
+  exclr = render_color(exclr);
+  bdclr = render_color(bdclr);
+  cdclr = render_color(cdclr);
+  piclr = render_color(piclr);
+  soclr = render_color(soclr);
+
+  if(number_of_colors == 0)
+    return;
+
+  ext_nbuckets = 16;
+  while(ext_nbuckets < 2 * (unsigned)number_of_colors)
+    ext_nbuckets *= 2;
+  ext_buckets = xmalloc(ext_nbuckets * sizeof(lscolor *));
+  patterns = xmalloc(number_of_colors * sizeof(lscolor *));
+
+  for(i = 0; i < number_of_colors; i++) {
+    lscolor *c = &clrs[i];
+
+    c->clr = render_color(c->clr);
+    c->suffix = mask_suffix(c->msk);
+    if(c->suffix) {
+      lscolor **pp = &ext_buckets[ext_hash(strrchr(c->suffix, '.') + 1)
+                                  & (ext_nbuckets - 1)];
+      c->suffixlen = strlen(c->suffix);
+      while(*pp)
+        pp = &(*pp)->next;
+      *pp = c;
+    } else
+      patterns[number_of_patterns++] = c;
+  }
+}
+
 void init_colors(void)
 {
   int i = 0;
@@ -121,6 +205,7 @@ void init_colors(void)
   if (!ec)
     ec = xstrdup("\x1B[0m");
 
+  compile_colors();
   colors_initialized = true;
 }
 
@@ -135,6 +220,8 @@ void free_colors(void)
     free(clrs[i].clr);
   }
   free(clrs);
+  free(ext_buckets);
+  free(patterns);
   free(diclr);
   free(lnclr);
   free(ficlr);
@@ -148,18 +235,57 @@ void free_colors(void)
   free(ec);
 
   clrs = NULL;
+  ext_buckets = NULL;
+  patterns = NULL;
+  number_of_colors = number_of_patterns = 0;
+  ext_nbuckets = 0;
   diclr = lnclr = ficlr = exclr = bdclr = cdclr = piclr = soclr = lc =
     rc = ec = NULL;
   colors_initialized = false;
 }
 
-void rfile_parse_colors(rfile *f)
+/* returns the first mask in LS_COLORS matching NAME, or 0 */
+static const lscolor *match_mask(const char *name)
 {
-  char *e, *q;
+  const lscolor *best = 0;
+  const char *ext = strrchr(name, '.');
   int i;
 
+  if(ext && ext_buckets) {
+    size_t len = strlen(name);
+    const lscolor *c = ext_buckets[ext_hash(ext + 1) & (ext_nbuckets - 1)];
+
+    for(; c; c = c->next) {
+      if(c->suffixlen <= len
+         && strcmp(name + len - c->suffixlen, c->suffix) == 0)
+      {
+        best = c;
+        break;
+      }
+    }
+  }
+
+  /* only patterns before the matching suffix in LS_COLORS can win */
+  for(i = 0; i < number_of_patterns && (!best || patterns[i] < best); i++) {
+    if(fnmatch(patterns[i]->msk, name, 0) == 0)
+      return patterns[i];
+  }
+  return best;
+}
+
+/* returns the escape sequence to print F in color; it's looked up the
+ * first time it's needed and shared by all files with the same color
+ */
+const char *rfile_color(rfile *f)
+{
+  const lscolor *c;
+  const char *e;
+
   /* colors should already been initialized by init_colors */
 
+  if(f->color)
+    return f->color;
+
   e = 0;
   if(risdir(f))
     e = diclr;
@@ -177,17 +303,14 @@ void rfile_parse_colors(rfile *f)
   /* do this before checking for executable, because
    * on [v]fat filesystems, all files are 'executable'
    */
-  for(i=0;i<number_of_colors && !e;i++) {
-    if(fnmatch(clrs[i].msk, base_name_ptr(f->path), 0) == 0)
-      e = clrs[i].clr;
-  }
+  if(!e && (c = match_mask(base_name_ptr(f->path))) != 0)
+    e = c->clr;
 
   /* a file is considered executable if there is
    * an 'x' anywhere in its permission string */
   if(!e && risexec(f))
     e = exclr;
 
-  q = e ? e : ficlr;
-  f->color = (char *)xmalloc(strlen(lc) + strlen(q) + strlen(rc) + 1);
-  sprintf(f->color, "%s%s%s", lc, q, rc);
+  f->color = e ? e : ficlr;
+  return f->color;
 }
@@ -16,11 +16,21 @@
 #include "ftp.h"
 #include "socket-impl.h"
 #include "xmalloc.h"
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 
 struct socket_impl_
 {
   int handle;
   FILE *sin, *sout;
+  int pipefds[2]; /* used by ps_splice_in() */
+  bool nosplice;
+  bool nosendfile;
+  int bufsize; /* minimum SO_RCVBUF/SO_SNDBUF, 0 for the default */
 };
 
 static bool create_streams(socket_impl* sock, const char* inmode,
@@ -79,6 +89,11 @@ static void ps_destroy(Socket* sockp)
   destroy_streams(sockp->data);
   if (sockp->data->handle != -1)
     close(sockp->data->handle);
+  if (sockp->data->pipefds[0] != -1)
+  {
+    close(sockp->data->pipefds[0]);
+    close(sockp->data->pipefds[1]);
+  }
   free(sockp->data);
   free(sockp);
 }
@@ -91,6 +106,26 @@ static bool ps_getsockname(Socket *sockp, struct sockaddr_storage* sa)
   return true;
 }
 
+static void apply_bufsize(socket_impl* sock)
+{
+#ifdef HAVE_SETSOCKOPT
+  const int opts[] = { SO_RCVBUF, SO_SNDBUF };
+  for (size_t i = 0; i < sizeof(opts) / sizeof(opts[0]); ++i)
+  {
+    /* never shrink a buffer the kernel has already grown */
+    int cur = 0;
+    socklen_t len = sizeof(cur);
+    if (getsockopt(sock->handle, SOL_SOCKET, opts[i], &cur, &len) == 0 &&
+        cur >= sock->bufsize)
+      continue;
+
+    if (setsockopt(sock->handle, SOL_SOCKET, opts[i], &sock->bufsize,
+                   sizeof(sock->bufsize)) == -1)
+      perror(_("setsockopt(SO_RCVBUF/SO_SNDBUF)... ignored"));
+  }
+#endif
+}
+
 static bool ps_connect_addr(Socket *sockp, const struct sockaddr* sa,
                             socklen_t salen)
 {
@@ -101,6 +136,10 @@ static bool ps_connect_addr(Socket *sockp, const struct sockaddr* sa,
   if (sockp->data->handle == -1)
     return false;
 
+  /* before connect(), so the TCP window scale is negotiated for it */
+  if (sockp->data->bufsize > 0)
+    apply_bufsize(sockp->data);
+
   /* connect to the socket */
   if (connect(sockp->data->handle, sa, salen) == -1)
   {
@@ -185,6 +224,10 @@ static bool ps_listen(Socket* sockp, int family)
   if (sockp->data->handle == -1)
     return false;
 
+  /* inherited by the accepted connection */
+  if (sockp->data->bufsize > 0)
+    apply_bufsize(sockp->data);
+
   socklen_t len = sizeof(struct sockaddr_storage);
   /* let system pick the port */
   if (family == AF_INET)
@@ -248,6 +291,25 @@ static void ps_lowdelay(Socket *sockp)
 #endif
 }
 
+static void ps_bufsize(Socket *sockp, int size)
+{
+  sockp->data->bufsize = size;
+  if (sockp->data->handle != -1 && size > 0)
+    apply_bufsize(sockp->data);
+}
+
+static int ps_rtt(Socket *sockp)
+{
+#if defined(TCP_INFO) && defined(__linux__)
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+  if (getsockopt(sockp->data->handle, IPPROTO_TCP, TCP_INFO, &info, &len) == 0
+      && info.tcpi_rtt > 0)
+    return info.tcpi_rtt;
+#endif
+  return -1;
+}
+
 static ssize_t ps_read(Socket *sockp, void *buf, size_t num)
 {
 #ifdef SECFTP
@@ -266,6 +328,89 @@ static ssize_t ps_write(Socket *sockp, const void* buf, size_t num)
 #endif
 }
 
+#if defined(HAVE_SPLICE) && !defined(SECFTP)
+static ssize_t ps_splice_in(Socket *sockp, int fd, size_t num)
+{
+  socket_impl* sock = sockp->data;
+
+  if (sock->nosplice)
+  {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  if (sock->pipefds[0] == -1 && pipe(sock->pipefds) == -1)
+  {
+    sock->pipefds[0] = sock->pipefds[1] = -1;
+    sock->nosplice = true;
+    errno = ENOSYS;
+    return -1;
+  }
+
+  const ssize_t n = splice(sock->handle, NULL, sock->pipefds[1], NULL, num,
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+  if (n == -1 && errno == EINVAL)
+  {
+    sock->nosplice = true;
+    errno = ENOSYS;
+  }
+  if (n <= 0)
+    return n;
+
+  size_t left = n;
+  while (left > 0)
+  {
+    const ssize_t w = splice(sock->pipefds[0], NULL, fd, NULL, left,
+                             SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (w == -1 && errno == EINTR)
+      continue;
+    if (w == -1 && errno == EINVAL)
+    {
+      /* FD doesn't support splice(), copy what is already in the pipe
+       * by hand and let the caller use sock_read() from now on */
+      char buf[4096];
+      sock->nosplice = true;
+      while (left > 0)
+      {
+        const ssize_t r = read(sock->pipefds[0], buf, min(left, sizeof(buf)));
+        if (r <= 0 || write(fd, buf, r) != r)
+          return -1;
+        left -= r;
+      }
+      break;
+    }
+    if (w <= 0)
+      return -1;
+    left -= w;
+  }
+
+  return n;
+}
+#endif
+
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H) && !defined(SECFTP)
+static ssize_t ps_sendfile_out(Socket *sockp, int fd, off_t *offset,
+                               size_t num)
+{
+  socket_impl* sock = sockp->data;
+
+  if (sock->nosendfile)
+  {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  const ssize_t n = sendfile(sock->handle, fd, offset, num);
+  if (n == -1 && (errno == EINVAL || errno == ENOSYS))
+  {
+    /* this kernel or FD doesn't support sendfile() */
+    sock->nosendfile = true;
+    errno = ENOSYS;
+  }
+  return n;
+}
+#endif
+
 static int ps_get(Socket *sockp)
 {
 #ifdef SECFTP
@@ -328,20 +473,37 @@ static int ps_error(Socket* sockp, bool inout)
 
 static int ps_check_pending(Socket* sockp, bool inout)
 {
-  struct timeval tv;
-  fd_set fds;
-
-  	/* watch fd to see if it has input */
-	FD_ZERO(&fds);
-  FD_SET(sockp->data->handle, &fds);
-	/* wait max 0.5 second */
-	tv.tv_sec = 0;
-	tv.tv_usec = 500000;
-
-	if (!inout) /* wait for read */
-		return select(sockp->data->handle + 1, &fds, NULL, NULL, &tv);
-	else /* wait for write */
-		return select(sockp->data->handle + 1, NULL, &fds, NULL, &tv);
+  struct pollfd pfd;
+
+  pfd.fd = sockp->data->handle;
+  /* wait for write or read */
+  pfd.events = inout ? POLLOUT : POLLIN;
+  pfd.revents = 0;
+
+  /* wait max 0.5 second */
+  const int r = poll(&pfd, 1, 500);
+  if (r > 0 && (pfd.revents & POLLNVAL))
+  {
+    errno = EBADF;
+    return -1;
+  }
+  /* errors and hangups are reported by the next read or write */
+  return r;
+}
+
+static bool ps_nonblocking(Socket* sockp, bool on)
+{
+#ifdef SECFTP
+  /* sec_read() and sec_write() expect blocking sockets */
+  return false;
+#else
+  const int flags = fcntl(sockp->data->handle, F_GETFL);
+  if (flags == -1)
+    return false;
+
+  return fcntl(sockp->data->handle, F_SETFL,
+               on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) != -1;
+#endif
 }
 
 static int ps_eof(Socket* sockp)
@@ -357,6 +519,7 @@ Socket* sock_create(void)
   sock->data = xmalloc(sizeof(socket_impl));
   memset(sock->data, 0, sizeof(socket_impl));
   sock->data->handle = -1;
+  sock->data->pipefds[0] = sock->data->pipefds[1] = -1;
 
   sock->destroy = ps_destroy;
   sock->connect_addr = ps_connect_addr;
@@ -365,8 +528,16 @@ Socket* sock_create(void)
   sock->listen = ps_listen;
   sock->throughput = ps_throughput;
   sock->lowdelay = ps_lowdelay;
+  sock->bufsize = ps_bufsize;
+  sock->rtt = ps_rtt;
   sock->read = ps_read;
   sock->write = ps_write;
+#if defined(HAVE_SPLICE) && !defined(SECFTP)
+  sock->splice_in = ps_splice_in;
+#endif
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H) && !defined(SECFTP)
+  sock->sendfile_out = ps_sendfile_out;
+#endif
   sock->get = ps_get;
   sock->put = ps_put;
   sock->vprintf = ps_vprintf;
@@ -375,6 +546,7 @@ Socket* sock_create(void)
   sock->eof = ps_eof;
   sock->telnet_interrupt = ps_telnet_interrupt;
   sock->check_pending = ps_check_pending;
+  sock->nonblocking = ps_nonblocking;
   sock->clear_error = ps_clearerr;
   sock->error = ps_error;
 
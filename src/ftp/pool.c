@@ -0,0 +1,175 @@
+/*
+ * pool.c -- pool of extra connections per host
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#include "syshdr.h"
+
+#include "ftp.h"
+#include "xmalloc.h"
+#include "gvars.h"
+
+/* list of extra logged in Ftp connections, kept open between
+ * commands so they can be reused by the next transfer to the same host
+ */
+static list *pool = 0;
+
+static void pool_quit(Ftp *pftp)
+{
+	Ftp *saved = ftp;
+
+	ftp_use(pftp);
+	if(ftp_connected()) {
+		ftp_reply_timeout(10);
+		ftp_set_tmp_verbosity(vbNone);
+		ftp_cmd("QUIT");
+	}
+	/* ftp_destroy() ends any security context on the current connection */
+	ftp_destroy(pftp);
+	ftp_use(saved);
+}
+
+/* returns true if PFTP is logged in to the same server and
+ * as the same user as URL
+ */
+static bool pool_match(Ftp *pftp, const url_t *url)
+{
+	const url_t *purl = pftp->url;
+
+	if(!purl || !purl->hostname || !url->hostname)
+		return false;
+	if(strcasecmp(purl->hostname, url->hostname) != 0
+	   || purl->port != url->port)
+		return false;
+	if(!purl->username || !url->username
+	   || strcmp(purl->username, url->username) != 0)
+		return false;
+	return true;
+}
+
+/* checks that the pooled connection PFTP is still alive, reconnects
+ * it if the server has timed it out
+ * returns 0 if PFTP is usable, else -1
+ */
+static int pool_check(Ftp *pftp)
+{
+	Ftp *saved = ftp;
+	int r = 0;
+
+	ftp_use(pftp);
+	if(ftp_connected() && ftp_loggedin()) {
+		ftp_set_tmp_verbosity(vbNone);
+		ftp_cmd("NOOP");
+	}
+	if(!ftp_connected() || !ftp_loggedin() || ftp->code != ctComplete) {
+		ftp_trace("pooled connection to %s timed out, reconnecting\n",
+				  saved->url->hostname);
+		r = ftp_reopen() == 0 ? 0 : -1;
+	}
+	ftp_use(saved);
+	return r;
+}
+
+/* opens a new connection to the same server as the current connection
+ * returns the logged in connection, or 0 on failure
+ */
+Ftp *ftp_pool_open(void)
+{
+	Ftp *saved = ftp;
+	Ftp *pftp;
+	url_t *u;
+	int r;
+
+	pftp = ftp_create();
+	pftp->verbosity = vbError;
+	pftp->reply_timeout = saved->reply_timeout;
+	pftp->open_timeout = saved->open_timeout;
+
+	u = url_clone(saved->url);
+	url_setdirectory(u, saved->curdir);
+
+	ftp_use(pftp);
+	r = ftp_open_url(u, true);
+	if(r == 0)
+		r = ftp_login(u->username, gvAnonPasswd);
+	url_destroy(u);
+	r = (r == 0 && ftp_loggedin()) ? 0 : -1;
+	ftp_use(saved);
+
+	if(r != 0) {
+		pool_quit(pftp);
+		return 0;
+	}
+	return pftp;
+}
+
+/* returns a list of up to N logged in connections to the same server
+ * (and as the same user) as the current connection, opening new ones
+ * as needed. The connections are owned by the pool and stay open after
+ * use, the returned list should be freed with list_free().
+ * The current connection is never part of the returned list.
+ */
+list *ftp_pool_acquire(unsigned int n)
+{
+	list *lp = list_new(0);
+	listitem *li, *next;
+
+	if(!ftp_loggedin() || !ftp->url)
+		return lp;
+#ifdef HAVE_LIBSSH
+	/* sftp sessions are not pooled */
+	if(ftp->session)
+		return lp;
+#endif
+
+	if(!pool)
+		pool = list_new((listfunc)pool_quit);
+
+	for(li=pool->first; li && (unsigned int)list_numitem(lp) < n; li=next) {
+		Ftp *pftp = (Ftp *)li->data;
+		next = li->next;
+
+		if(!pool_match(pftp, ftp->url))
+			continue;
+		if(pool_check(pftp) != 0) {
+			list_delitem(pool, li);
+			continue;
+		}
+		list_additem(lp, pftp);
+	}
+
+	while((unsigned int)list_numitem(lp) < n) {
+		Ftp *pftp = ftp_pool_open();
+		if(!pftp)
+			break;
+		list_additem(pool, pftp);
+		list_additem(lp, pftp);
+	}
+
+	ftp_trace("using %d pooled connections to %s\n",
+			  list_numitem(lp), ftp->url->hostname);
+	return lp;
+}
+
+/* closes all pooled connections */
+void ftp_pool_quit_all(void)
+{
+	list_free(pool);
+	pool = 0;
+}
+
+/* forgets the pooled connections without logging them out, for use in a
+ * forked child: the sockets are shared with the parent, which still owns
+ * the connections, so they must not be used or closed from here
+ */
+void ftp_pool_detach(void)
+{
+	pool = 0;
+}
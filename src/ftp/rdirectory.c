@@ -14,10 +14,157 @@
 #include "ftp.h"
 #include "strq.h"
 
+#define ARENA_MINBLOCK 1024
+#define ARENA_BLOCKSIZE 32768
+#define ARENA_ALIGN sizeof(long long)
+
+/* storage for the rfiles of a directory and their strings, freed all at
+ * once with the directory; perm, owner, group and date are
+ * interned, since most files in a directory share them
+ */
+typedef struct arena_block
+{
+  struct arena_block *next;
+  size_t used, size;
+} arena_block;
+
+struct rdir_arena
+{
+  arena_block *blocks;
+  size_t memory;
+  const char **strings;   /* hash table of interned strings */
+  unsigned int nstrings, size;
+};
+
+static void *arena_alloc(rdir_arena *a, size_t n, size_t align)
+{
+  arena_block *b = a->blocks;
+  size_t start = 0;
+
+  if (b)
+    start = (b->used + align - 1) & ~(align - 1);
+  if (!b || start + n > b->size) {
+    /* blocks grow with the directory, small directories are common */
+    size_t size = a->memory < ARENA_MINBLOCK ? ARENA_MINBLOCK : a->memory;
+    size_t hdr = (sizeof(arena_block) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    bool large;
+
+    if (size > ARENA_BLOCKSIZE)
+      size = ARENA_BLOCKSIZE;
+    large = (n > size / 4);
+    if (large)
+      size = n;
+    b = xmalloc(hdr + size);
+    b->used = hdr;
+    b->size = hdr + size;
+    a->memory += b->size;
+    if (a->blocks && large) {
+      /* keep filling the current block after a large allocation */
+      b->next = a->blocks->next;
+      a->blocks->next = b;
+    } else {
+      b->next = a->blocks;
+      a->blocks = b;
+    }
+    start = b->used;
+  }
+  b->used = start + n;
+  return (char *)b + start;
+}
+
+static char *arena_strdup(rdir_arena *a, const char *s)
+{
+  size_t len;
+  char *r;
+
+  if (!s)
+    return 0;
+  len = strlen(s) + 1;
+  r = arena_alloc(a, len, 1);
+  memcpy(r, s, len);
+  return r;
+}
+
+static unsigned int arena_hash(const char *s)
+{
+  unsigned int h = 2166136261U;   /* FNV-1a */
+
+  while (*s) {
+    h ^= (unsigned char)*s++;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+static void arena_grow_strings(rdir_arena *a)
+{
+  unsigned int size = a->size ? a->size * 2 : 64;
+  const char **strings = xmalloc(size * sizeof(char *));
+  unsigned int i;
+
+  for (i = 0; i < a->size; i++) {
+    if (a->strings[i]) {
+      unsigned int j = arena_hash(a->strings[i]) & (size - 1);
+      while (strings[j])
+        j = (j + 1) & (size - 1);
+      strings[j] = a->strings[i];
+    }
+  }
+  free(a->strings);
+  a->strings = strings;
+  a->size = size;
+}
+
+/* returns a copy of S in the arena, shared with equal strings */
+static char *arena_intern(rdir_arena *a, const char *s)
+{
+  unsigned int i;
+
+  if (!s)
+    return 0;
+  if (2 * (a->nstrings + 1) > a->size)
+    arena_grow_strings(a);
+
+  i = arena_hash(s) & (a->size - 1);
+  while (a->strings[i]) {
+    if (strcmp(a->strings[i], s) == 0)
+      return (char *)a->strings[i];
+    i = (i + 1) & (a->size - 1);
+  }
+  a->strings[i] = arena_strdup(a, s);
+  a->nstrings++;
+  return (char *)a->strings[i];
+}
+
+static void arena_free(rdir_arena *a)
+{
+  arena_block *b, *next;
+
+  if (!a)
+    return;
+  for (b = a->blocks; b; b = next) {
+    next = b->next;
+    free(b);
+  }
+  free(a->strings);
+  free(a);
+}
+
+/* forgets the name index, it is rebuilt by the next rdir_get_file()
+ * must be called whenever rdir->files changes
+ */
+static void rdir_drop_index(rdirectory *rdir)
+{
+  free(rdir->index);
+  rdir->index = 0;
+  rdir->nindex = 0;
+}
+
 rdirectory *rdir_create(void)
 {
   rdirectory* rdir = xmalloc(sizeof(rdirectory));
-  rdir->files = list_new((listfunc)rfile_destroy);
+  /* the files are in rdir->arena */
+  rdir->files = list_new(0);
   rdir->timestamp = time(0);
 
   return rdir;
@@ -29,68 +176,267 @@ void rdir_destroy(rdirectory *rdir)
     return;
 
   list_free(rdir->files);
+  arena_free(rdir->arena);
   free(rdir->path);
+  free(rdir->index);
   free(rdir);
 }
 
+/* adds a copy of F to RDIR, F is not modified
+ *
+ * the copy is owned by RDIR and must not be destroyed, use rfile_clone()
+ * to get a file that outlives the directory. Its strings live in the
+ * arena and must not be changed; only these fields may be updated in
+ * place, so the cached file stays the one place that knows them:
+ *   size, mtime and exact, refreshed from SIZE and MDTM replies by
+ *     ftp_filesize(), ftp_filetime() and ftp_filetime_prefetch()
+ *   color, set by rfile_color() to remember its LS_COLORS lookup, it
+ *     points into the compiled colors and is not owned by the file
+ */
+rfile *rdir_add_file(rdirectory *rdir, const rfile *f)
+{
+  rdir_arena *a = rdir->arena;
+  rfile *nf;
+
+  if (!a)
+    a = rdir->arena = xmalloc(sizeof(rdir_arena));
+
+  nf = arena_alloc(a, sizeof(rfile), ARENA_ALIGN);
+  nf->perm = arena_intern(a, f->perm);
+  nf->owner = arena_intern(a, f->owner);
+  nf->group = arena_intern(a, f->group);
+  nf->color = f->color;
+  nf->date = arena_intern(a, f->date);
+  nf->link = arena_strdup(a, f->link);
+  nf->path = arena_strdup(a, f->path);
+  nf->mtime = f->mtime;
+  nf->nhl = f->nhl;
+  nf->size = f->size;
+  nf->exact = f->exact;
+
+  list_additem(rdir->files, nf);
+  rdir_drop_index(rdir);
+  return nf;
+}
+
 unsigned long int rdir_size(rdirectory *rdir)
 {
   return rglob_size(rdir->files);
 }
 
+/* returns the approximate amount of memory used by RDIR */
+size_t rdir_memsize(rdirectory *rdir)
+{
+  size_t size = sizeof(rdirectory) + sizeof(list);
+
+  if (rdir->path)
+    size += strlen(rdir->path) + 1;
+  size += list_numitem(rdir->files) * (sizeof(listitem) + sizeof(rfile *));
+  if (rdir->arena)
+    size += sizeof(rdir_arena) + rdir->arena->memory
+      + rdir->arena->size * sizeof(char *);
+  return size;
+}
+
+struct rdir_parser
+{
+  rdirectory *rdir;
+  char *path;
+  bool is_mlsd;
+  bool done;      /* an empty line ends the listing */
+  bool failed;
+  char *line;     /* incomplete line, waiting for more data */
+  size_t len, size;
+  rfile *f;       /* scratch file, copied into the directory */
+};
+
+/* starts parsing a listing of directory PATH into RDIR, the listing is
+ * passed to rdir_parse_feed() as it arrives and rdir_parse_end() must
+ * be called when it's complete
+ */
+rdir_parser *rdir_parse_begin(rdirectory *rdir, const char *path, bool is_mlsd)
+{
+  rdir_parser *p = xmalloc(sizeof(rdir_parser));
+
+  free(rdir->path);
+  rdir->path = 0;
+  list_clear(rdir->files);
+  arena_free(rdir->arena);
+  rdir->arena = 0;
+  rdir_drop_index(rdir);
+  rdir->timestamp = time(0);
+
+  p->rdir = rdir;
+  p->path = xstrdup(path);
+  p->is_mlsd = is_mlsd;
+  p->f = rfile_create();
+
+  ftp_trace("*** start parsing directory listing of '%s' ***\n", path);
+  return p;
+}
+
+static void rdir_parse_line(rdir_parser *p, char *line)
+{
+  int r;
+
+  strip_trailing_chars(line, "\r\n");
+  if (!line[0]) {
+    p->done = true;
+    return;
+  }
+  ftp_trace("%s\n", line);
+
+  rfile_clear(p->f);
+  r = rfile_parse(p->f, line, p->path, p->is_mlsd);
+  if (r == -1) {
+    ftp_err("parsing failed on '%s'\n", line);
+    list_clear(p->rdir->files);
+    rdir_drop_index(p->rdir);
+    p->failed = true;
+  } else if (r == 0)
+    rdir_add_file(p->rdir, p->f);
+  /* else r == 1, ie a 'total ###' line, which isn't an error */
+}
+
+static void rdir_parse_append(rdir_parser *p, const char *data, size_t n)
+{
+  if (p->len + n > p->size) {
+    p->size = (p->len + n) * 2;
+    p->line = xrealloc(p->line, p->size);
+  }
+  memcpy(p->line + p->len, data, n);
+  p->len += n;
+}
+
+/* parses the N bytes of listing in DATA, a line split between two
+ * calls is kept until the rest of it arrives; DATA is modified
+ *
+ * PARSER is a rdir_parser, so this can be used as an ftp_data_func
+ */
+int rdir_parse_feed(char *data, size_t n, void *parser)
+{
+  rdir_parser *p = (rdir_parser *)parser;
+  char *e = data + n;
+
+  while (data < e && !p->done) {
+    char *nl = memchr(data, '\n', e - data);
+    if (!nl) {
+      rdir_parse_append(p, data, e - data);
+      break;
+    }
+    *nl = 0;
+    if (p->len) {
+      rdir_parse_append(p, data, nl - data + 1);
+      rdir_parse_line(p, p->line);
+      p->len = 0;
+    } else
+      rdir_parse_line(p, data);
+    data = nl + 1;
+  }
+  return 0;
+}
+
+/* finishes parsing the listing and frees P
+ * returns 0 on success, -1 if no file could be parsed
+ */
+int rdir_parse_end(rdir_parser *p)
+{
+  int r = 0;
+
+  if (p->len && !p->done) {
+    rdir_parse_append(p, "", 1);
+    rdir_parse_line(p, p->line);
+  }
+  ftp_trace("*** end parsing directory listing ***\n");
+
+  if (p->failed && list_numitem(p->rdir->files) == 0) {
+    ftp_err("directory parsing failed completely\n");
+    r = -1;
+  } else
+    p->rdir->path = xstrdup(p->path);
+
+  rfile_destroy(p->f);
+  free(p->line);
+  free(p->path);
+  free(p);
+  return r;
+}
+
 int rdir_parse(rdirectory *rdir, FILE *fp, const char *path, bool is_mlsd)
 {
-	rfile *f;
-	int r;
-	bool failed = false;
-
-	free(rdir->path);
-	rdir->path = 0;
-	list_clear(rdir->files);
-	rdir->timestamp = time(0);
-
-	f = rfile_create();
-
-	ftp_trace("*** start parsing directory listing of '%s' ***\n", path);
-
-	while(!feof(fp)) {
-		char tmp[512];
-		if(fgets(tmp, sizeof(tmp), fp) == 0)
-			break;
-		strip_trailing_chars(tmp, "\r\n");
-		if(!tmp[0])
-			break;
-		ftp_trace("%s\n", tmp);
-
-		rfile_clear(f);
-		r = rfile_parse(f, tmp, path, is_mlsd);
-		if(r == -1) {
-			ftp_err("parsing failed on '%s'\n", tmp);
-			list_clear(rdir->files);
-			failed = true;
-		} else if(r == 0)
-			list_additem(rdir->files, (void *)rfile_clone(f));
-		/* else r == 1, ie a 'total ###' line, which isn't an error */
-	}
-  rfile_destroy(f);
-	ftp_trace("*** end parsing directory listing ***\n");
-	if(failed) {
-		if(list_numitem(rdir->files) == 0) {
-			ftp_err("directory parsing failed completely\n");
-			return -1;
-		}
-	}
-	rdir->path = xstrdup(path);
-	return 0;
+  rdir_parser *p = rdir_parse_begin(rdir, path, is_mlsd);
+  char buf[4096];
+  size_t n;
+
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    rdir_parse_feed(buf, n, p);
+  return rdir_parse_end(p);
 }
 
+/* a file and its position in the directory, files with the same name
+ * keep their order in the index */
+typedef struct index_entry
+{
+  rfile *f;
+  unsigned int pos;
+} index_entry;
+
+static int compare_names(const void *A, const void *B)
+{
+  const index_entry *a = A;
+  const index_entry *b = B;
+  int r = strcmp(base_name_ptr(a->f->path), base_name_ptr(b->f->path));
+
+  if (r == 0)
+    r = (a->pos > b->pos) - (a->pos < b->pos);
+  return r;
+}
+
+static int compare_name_key(const void *key, const void *B)
+{
+  const rfile *b = *(const rfile **)B;
+
+  return strcmp((const char *)key, base_name_ptr(b->path));
+}
+
+/* builds the name index searched by rdir_get_file() */
+static void rdir_build_index(rdirectory *rdir)
+{
+  listitem *li;
+  index_entry *entries;
+  unsigned int i = 0;
+
+  free(rdir->index);
+  rdir->nindex = list_numitem(rdir->files);
+  entries = xmalloc((rdir->nindex + 1) * sizeof(index_entry));
+  for (li = rdir->files->first; li; li = li->next, i++) {
+    entries[i].f = (rfile *)li->data;
+    entries[i].pos = i;
+  }
+  qsort(entries, rdir->nindex, sizeof(index_entry), compare_names);
+
+  rdir->index = xmalloc((rdir->nindex + 1) * sizeof(rfile *));
+  for (i = 0; i < rdir->nindex; i++)
+    rdir->index[i] = entries[i].f;
+  free(entries);
+}
+
+/* returns the first file in RDIR named FILENAME, or NULL */
 rfile *rdir_get_file(rdirectory *rdir, const char *filename)
 {
-  listitem* li = list_search(rdir->files, (listsearchfunc)rfile_search_filename,
-      filename);
-  if (li)
-    return (rfile*)li->data;
-  return NULL;
+  rfile **fp;
+
+  if (!rdir->index)
+    rdir_build_index(rdir);
+
+  fp = bsearch(filename, rdir->index, rdir->nindex, sizeof(rfile *),
+      compare_name_key);
+  if (!fp)
+    return NULL;
+  /* bsearch() finds any of several files with the same name */
+  while (fp > rdir->index && compare_name_key(filename, fp - 1) == 0)
+    fp--;
+  return *fp;
 }
 
 static int compare_files(const void* A, const void* B)
@@ -110,4 +456,5 @@ void rdir_sort(rdirectory* dir)
     return;
 
   list_sort(dir->files, compare_files, false);
+  rdir_drop_index(dir);
 }
@@ -17,18 +17,30 @@
 #include "rfile.h"
 #include "linklist.h"
 
+typedef struct rdir_parser rdir_parser;
+typedef struct rdir_arena rdir_arena;
+
 typedef struct rdirectory
 {
   char *path;        /* directory path */
   list *files;       /* linked list of rfiles */
   time_t timestamp;  /* time of creation */
+  rfile **index;     /* files sorted by name, for rdir_get_file(), or 0
+                      * if files changed since it was built */
+  unsigned int nindex;
+  rdir_arena *arena; /* storage of the files */
 } rdirectory;
 
 rdirectory* rdir_create(void);
 void rdir_destroy(rdirectory *rdir);
+rfile *rdir_add_file(rdirectory *rdir, const rfile *f);
 int rdir_parse(rdirectory *rdir, FILE *fp, const char *path, bool is_mlsd);
+rdir_parser *rdir_parse_begin(rdirectory *rdir, const char *path, bool is_mlsd);
+int rdir_parse_feed(char *data, size_t n, void *parser);
+int rdir_parse_end(rdir_parser *p);
 rfile* rdir_get_file(rdirectory *rdir, const char *filename);
 unsigned long int rdir_size(rdirectory* rdir);
+size_t rdir_memsize(rdirectory *rdir);
 void rdir_sort(rdirectory* rdir);
 
 #endif
@@ -25,13 +25,14 @@ rfile *rfile_clone(const rfile *f)
   nf->perm = xstrdup(f->perm);
   nf->owner = xstrdup(f->owner);
   nf->group = xstrdup(f->group);
-  nf->color = xstrdup(f->color);
+  nf->color = f->color;
   nf->date = xstrdup(f->date);
   nf->link = xstrdup(f->link);
   nf->path = xstrdup(f->path);
   nf->size = f->size;
   nf->nhl = f->nhl;
   nf->mtime = f->mtime;
+  nf->exact = f->exact;
 
   return nf;
 }
@@ -41,15 +42,16 @@ void rfile_clear(rfile *f)
   free(f->perm);
   free(f->owner);
   free(f->group);
-  free(f->color);
   free(f->date);
   free(f->link);
   free(f->path);
-  f->perm = f->owner = f->group = f->color = NULL;
+  f->perm = f->owner = f->group = NULL;
+  f->color = NULL;
   f->date = f->link = f->path = NULL;
   f->nhl = 0;
   f->size = 0L;
   f->mtime = (time_t)0;
+  f->exact = 0;
 }
 
 void rfile_destroy(rfile *f)
@@ -60,6 +62,19 @@ void rfile_destroy(rfile *f)
   free(f);
 }
 
+static size_t strsize(const char *str)
+{
+  return str ? strlen(str) + 1 : 0;
+}
+
+/* returns the approximate amount of memory used by F */
+size_t rfile_memsize(const rfile *f)
+{
+  return sizeof(rfile) + strsize(f->perm) + strsize(f->owner)
+    + strsize(f->group) + strsize(f->date)
+    + strsize(f->link) + strsize(f->path);
+}
+
 bool risdir(const rfile *f)
 {
     return (f->perm[0] == 'd');
@@ -126,7 +141,7 @@ void rfile_fake(rfile *f, const char *path)
     f->mtime = 0;
     f->nhl = 0;
     f->size = (unsigned long long)-1;
-    rfile_parse_colors(f);
+    f->color = 0;
 }
 
 char rfile_classchar(const rfile *f)
@@ -335,7 +350,6 @@ static int rfile_parse_eplf(rfile *f, char *str, const char *dirpath)
     }
     if (!f->path)
         return -1;
-    rfile_parse_colors(f);
 
     return 0;
 }
@@ -566,8 +580,6 @@ static int rfile_parse_unix(rfile *f, char *str, const char *dirpath)
       return -1;
     }
 
-    rfile_parse_colors(f);
-
     return 0;
 }
 
@@ -652,8 +664,6 @@ static int rfile_parse_dos(rfile *f, char *str, const char *dirpath)
       return -1;
     }
 
-    rfile_parse_colors(f);
-
     return 0;
 }
 
@@ -683,6 +693,7 @@ static int rfile_parse_mlsd(rfile *f, char *str, const char *dirpath)
     f->perm = 0;
     f->size = 0L;
     f->mtime = 0;
+    f->exact = 0;
     f->link = 0;
     f->nhl = 0;
     f->owner = xstrdup("owner");
@@ -699,8 +710,10 @@ static int rfile_parse_mlsd(rfile *f, char *str, const char *dirpath)
             return -1;
         }
 
-        if(strcasecmp(factname, "size") == 0 ||
-            strcasecmp(factname, "sizd") == 0)
+        if(strcasecmp(factname, "size") == 0) {
+            f->size = strtoull(value,NULL,10);
+            f->exact |= RFILE_EXACT_SIZE;
+        } else if(strcasecmp(factname, "sizd") == 0)
             /* the "sizd" fact is not standardized in "Extension to
              * FTP" Internet draft, but PureFTPd uses it for some
              * reason for size of directories
@@ -722,6 +735,7 @@ static int rfile_parse_mlsd(rfile *f, char *str, const char *dirpath)
             ts.tm_year -= 1900;
             ts.tm_mon--;
             f->mtime = gmt_mktime(&ts);
+            f->exact |= RFILE_EXACT_MTIME;
             free(f->date);
             f->date = time_to_string(f->mtime);
         } else if(strcasecmp(factname, "UNIX.mode") == 0) {
@@ -742,8 +756,6 @@ static int rfile_parse_mlsd(rfile *f, char *str, const char *dirpath)
     if(isdir)
         f->perm[0] = 'd';
 
-    rfile_parse_colors(f);
-
     return 0;
 }
 
@@ -752,6 +764,7 @@ int rfile_parse(rfile *f, char *str, const char *dirpath, bool is_mlsd)
     int i;
     int r = -1;
 
+    f->exact = 0;
     if(is_mlsd) {
         char *tmp = xstrdup(str);
         r = rfile_parse_mlsd(f, tmp, dirpath);
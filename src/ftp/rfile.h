@@ -20,19 +20,26 @@ typedef struct rfile
   char *perm;
   char *owner;
   char *group;
-  char *color;
+  const char *color;  /* shared, set by rfile_color() */
   char *date;         /* date and time as a string */
   time_t mtime;       /* modification time */
   unsigned int nhl;   /* number of hard links */
   char *link;         /* target of link */
   char *path;         /* filename with absolute path */
   unsigned long long int size;
+  unsigned int exact; /* RFILE_EXACT_* */
 } rfile;
 
+/* the modification time or size is exact, from MLSD facts or an MDTM
+ * or SIZE reply, not parsed from a LIST line */
+#define RFILE_EXACT_MTIME 1
+#define RFILE_EXACT_SIZE 2
+
 rfile* rfile_create(void);
 void rfile_clear(rfile *f);
 void rfile_destroy(rfile *f);
 rfile* rfile_clone(const rfile *f);
+size_t rfile_memsize(const rfile *f);
 
 bool risdir(const rfile *f);
 bool risdotdir(const rfile *f);
@@ -46,7 +53,7 @@ bool rislink(const rfile *f);
 
 void rfile_fake(rfile *f, const char *path);
 int rfile_parse(rfile *f, char *str, const char *dirpath, bool is_mlsd);
-void rfile_parse_colors(rfile *f);
+const char *rfile_color(rfile *f);
 
 int month_number(const char *str);
 void rfile_parse_time(rfile *f, const char *m, const char *d, const char *y);
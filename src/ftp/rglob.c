@@ -13,6 +13,7 @@
 #include "syshdr.h"
 #include "ftp.h"
 #include "strq.h"
+#include "strset.h"
 
 list *rglob_create(void)
 {
@@ -29,6 +30,17 @@ bool rglob_exclude_dotdirs(rfile *f)
 	return risdotdir(f);
 }
 
+/* returns a set of the paths of the files in GL */
+static strset *rglob_paths(list *gl)
+{
+	strset *paths = strset_new();
+	listitem *li;
+
+	for(li = gl->first; li; li = li->next)
+		strset_add(paths, ((rfile *)li->data)->path);
+	return paths;
+}
+
 /* appends rglob items in list LP matching MASK
  * EXCLUDE_FUNC (if not 0) is called for each fileinfo item found
  * and that file is excluded if EXCLUDE_FUNC returns true
@@ -47,6 +59,7 @@ int rglob_glob(list *gl, const char *mask, bool cpifnomatch,
 	rdirectory *rdir;
 	listitem *lip;
 	rfile *fi = 0, *nfi;
+	strset *paths = 0;
 	char *d;
 	int found = 0;
 
@@ -68,6 +81,9 @@ int rglob_glob(list *gl, const char *mask, bool cpifnomatch,
 	rdir = ftp_get_directory(d);
 	free(d);
 
+	if(ignore_multiples)
+		paths = rglob_paths(gl);
+
 	if(rdir) {
 		lip = rdir->files->first;
 		while(lip) {
@@ -89,13 +105,13 @@ int rglob_glob(list *gl, const char *mask, bool cpifnomatch,
 					ignore_item = true;
 				else
 					ignore_item =
-						(ignore_multiples &&
-						 (list_search(gl, (listsearchfunc)rfile_search_path,
-										  fi->path) != 0));
+						(ignore_multiples && strset_contains(paths, fi->path));
 
 				if(!ignore_item) {
 					nfi = rfile_clone(fi);
 					list_additem(gl, (void *)nfi);
+					if(paths)
+						strset_add(paths, nfi->path);
 				} else
 					ftp_trace("ignoring file '%s'\n", fi->path);
 			}
@@ -107,6 +123,7 @@ int rglob_glob(list *gl, const char *mask, bool cpifnomatch,
 		bool ignore_item;
 
 		if(!cpifnomatch || mp == 0 || *mp == 0) {
+			strset_free(paths);
 			free(mp);
 			return -1;
 		}
@@ -114,10 +131,7 @@ int rglob_glob(list *gl, const char *mask, bool cpifnomatch,
 		unquote(p);
 
 		/* disallow multiples of the same file */
-		ignore_item =
-			(ignore_multiples &&
-			 (list_search(gl, (listsearchfunc)rfile_search_path,
-						  p)) != 0);
+		ignore_item = (ignore_multiples && strset_contains(paths, p));
 
 		if(!ignore_item) {
 			nfi = rfile_create();
@@ -127,6 +141,7 @@ int rglob_glob(list *gl, const char *mask, bool cpifnomatch,
 		free(p);
 	}
 
+	strset_free(paths);
 	free(mp);
 	free(path);
 	return 0;
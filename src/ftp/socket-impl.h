@@ -30,8 +30,12 @@ struct Socket_
   bool (*listen)(Socket *sockp, int family);
   void (*throughput)(Socket *sockp);
   void (*lowdelay)(Socket *sockp);
+  void (*bufsize)(Socket *sockp, int size);
+  int (*rtt)(Socket *sockp);
   ssize_t (*read)(Socket *sockp, void *buf, size_t num);
   ssize_t (*write)(Socket *sockp, const void *buf, size_t num);
+  ssize_t (*splice_in)(Socket *sockp, int fd, size_t num);
+  ssize_t (*sendfile_out)(Socket *sockp, int fd, off_t *offset, size_t num);
   int (*get)(Socket *sockp); /* get one character */
   int (*put)(Socket *sockp, int c); /* put one character */
   int (*vprintf)(Socket *sockp, const char *str, va_list ap);
@@ -41,6 +45,7 @@ struct Socket_
   int (*telnet_interrupt)(Socket *sockp);
 
   int (*check_pending)(Socket* sock, bool inout);
+  bool (*nonblocking)(Socket* sock, bool on);
 
   void (*clear_error)(Socket* sockp, bool inout);
   int (*error)(Socket* sockp, bool input);
@@ -90,6 +90,26 @@ void sock_lowdelay(Socket *sockp)
     sockp->lowdelay(sockp);
 }
 
+/* makes the kernel send and receive buffers at least SIZE bytes, now or
+ * when the socket is created by sock_connect_addr() or sock_listen()
+ */
+void sock_bufsize(Socket *sockp, int size)
+{
+  if (sockp && sockp->bufsize)
+    sockp->bufsize(sockp, size);
+}
+
+/* returns the smoothed round trip time of the connection in
+ * microseconds, or -1 if unknown
+ */
+int sock_rtt(Socket *sockp)
+{
+  if (!sockp || !sockp->rtt)
+    return -1;
+
+  return sockp->rtt(sockp);
+}
+
 const struct sockaddr* sock_local_addr(Socket *sockp)
 {
   if (!sockp)
@@ -122,6 +142,39 @@ ssize_t sock_write(Socket *sockp, const void* buf, size_t num)
   return sockp->write(sockp, buf, num);
 }
 
+/* moves up to NUM bytes from the socket to the file descriptor FD
+ * without copying them through userspace
+ * returns the number of bytes moved, 0 on EOF or -1 on error; errno is
+ * ENOSYS if this socket or FD can't do that, use sock_read() instead
+ */
+ssize_t sock_splice_in(Socket *sockp, int fd, size_t num)
+{
+  if (!sockp || !sockp->splice_in)
+  {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  return sockp->splice_in(sockp, fd, num);
+}
+
+/* sends up to NUM bytes from the file descriptor FD, starting at *OFFSET,
+ * over the socket without copying them through userspace
+ * *OFFSET is advanced by the number of bytes sent, which is returned;
+ * returns 0 on end of file or -1 on error, errno is ENOSYS if this socket
+ * or FD can't do that, use sock_write() instead
+ */
+ssize_t sock_sendfile_out(Socket *sockp, int fd, off_t *offset, size_t num)
+{
+  if (!sockp || !sockp->sendfile_out)
+  {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  return sockp->sendfile_out(sockp, fd, offset, num);
+}
+
 int sock_get(Socket *sockp)
 {
   if (!sockp || !sockp->get)
@@ -232,3 +285,15 @@ int sock_check_pending(Socket* sockp, bool inout)
 
   return sockp->check_pending(sockp, inout);
 }
+
+/* turns non-blocking mode on or off
+ * returns false if the socket can't be put in non-blocking mode; reads
+ * and writes then block and should be preceded by sock_check_pending()
+ */
+bool sock_nonblocking(Socket* sockp, bool on)
+{
+  if (!sockp || !sockp->nonblocking)
+    return false;
+
+  return sockp->nonblocking(sockp, on);
+}
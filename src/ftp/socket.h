@@ -30,10 +30,14 @@ bool sock_accept(Socket *sockp, const char *mode, bool pasvmode);
 bool sock_listen(Socket *sockp, int family);
 void sock_throughput(Socket *sockp);
 void sock_lowdelay(Socket *sockp);
+void sock_bufsize(Socket *sockp, int size);
+int sock_rtt(Socket *sockp);
 const struct sockaddr* sock_local_addr(Socket *sockp);
 const struct sockaddr* sock_remote_addr(Socket *sockp);
 ssize_t sock_read(Socket *sockp, void *buf, size_t num);
 ssize_t sock_write(Socket *sockp, const void *buf, size_t num);
+ssize_t sock_splice_in(Socket *sockp, int fd, size_t num);
+ssize_t sock_sendfile_out(Socket *sockp, int fd, off_t *offset, size_t num);
 int sock_get(Socket *sockp); /* get one character */
 int sock_put(Socket *sockp, int c); /* put one character */
 int sock_vprintf(Socket *sockp, const char *str, va_list ap);
@@ -51,5 +55,6 @@ void sock_clearerr_out(Socket* sockp);
 int sock_error_out(Socket* sockp);
 int sock_error_in(Socket* sockp);
 int sock_check_pending(Socket* sockp, bool inout);
+bool sock_nonblocking(Socket* sockp, bool on);
 
 #endif
@@ -541,13 +541,13 @@ rdirectory* ssh_read_directory(const char *path)
     rf->mtime = attrib->mtime;
     rf->date = time_to_string(rf->mtime);
     rf->size = attrib->size;
-    rfile_parse_colors(rf);
 
     rf->link = NULL;
     if (rislink(rf) && ftp->ssh_version > 2)
       rf->link = sftp_readlink(ftp->sftp_session, rf->path);
 
-    list_additem(rdir->files, (void *)rf);
+    rdir_add_file(rdir, rf);
+    rfile_destroy(rf);
     sftp_attributes_free(attrib);
   }
   ftp_trace("*** end parsing directory listing ***\n");
@@ -564,8 +564,7 @@ rdirectory* ssh_read_directory(const char *path)
   sftp_closedir(dir);
   rdir->path = p;
   rdir_sort(rdir);
-  ftp_trace("added directory '%s' to cache\n", p);
-  list_additem(ftp->cache, rdir);
+  ftp_cache_add(rdir);
 
   return rdir;
 }
@@ -660,6 +659,8 @@ static int do_scp_read(ssh_scp scp, const char* infile, FILE* fp,
       return -1;
     }
 
+    if (ftp->data_checksum)
+      checksum_update(ftp->data_checksum, buffer, r);
     ftp->ti.size += r;
     if (hookf)
     {
@@ -772,6 +773,8 @@ static int do_read(const char* infile, FILE* fp, transfer_mode_t mode,
       return -1;
     }
 
+    if (ftp->data_checksum)
+      checksum_update(ftp->data_checksum, buffer, nbytes);
     ftp->ti.size += nbytes;
     if (hookf)
     {
@@ -863,6 +866,8 @@ static int do_scp_write(ssh_scp scp, const char* path, FILE* fp,
       return -1;
     }
 
+    if (ftp->data_checksum)
+      checksum_update(ftp->data_checksum, buffer, nbytes);
     ftp->ti.size += nbytes;
     if (hookf)
     {
@@ -961,6 +966,8 @@ static int do_write(const char* path, FILE* fp, ftp_transfer_func hookf,
       return -1;
     }
 
+    if (ftp->data_checksum)
+      checksum_update(ftp->data_checksum, buffer, nbytes);
     ftp->ti.size += nbytes;
     if (hookf)
     {
@@ -1007,7 +1014,7 @@ int ssh_send(const char *path, FILE *fp, putmode_t how,
 
   if(how == putAppend) {
     ftp_set_tmp_verbosity(vbNone);
-    offset = ftp_filesize(p);
+    offset = ftp_filesize(p, false);
   }
 
   int r = do_write(p, fp, hookf, offset);
@@ -1017,6 +1024,91 @@ int ssh_send(const char *path, FILE *fp, putmode_t how,
   return r;
 }
 
+/* runs sha256sum or md5sum on the remote file PATH
+ * returns the checksum in hex (malloc'd) or 0 on error
+ */
+char *ssh_checksum(const char *path, checksum_t type)
+{
+  const char *prog = type == csSHA256 ? "sha256sum"
+    : type == csMD5 ? "md5sum" : NULL;
+  if (!prog)
+    return NULL;
+
+  ssh_channel channel = ssh_channel_new(ftp->session);
+  if (!channel)
+    return NULL;
+  if (ssh_channel_open_session(channel) != SSH_OK)
+  {
+    ftp_err(_("Couldn't open channel: %s\n"), ssh_get_error(ftp->session));
+    ssh_channel_free(channel);
+    return NULL;
+  }
+
+  char* p = ftp_path_absolute(path);
+  char* escaped = backslash_quote(p);
+  char* cmd = NULL;
+  free(p);
+  if (asprintf(&cmd, "%s %s", prog, escaped) == -1)
+    cmd = NULL;
+  free(escaped);
+
+  /* the output is "<checksum>  <path>" */
+  char buffer[CHECKSUM_HEXLEN + 1];
+  int nbytes = 0;
+  if (cmd && ssh_channel_request_exec(channel, cmd) == SSH_OK)
+  {
+    int r;
+    while (nbytes < (int)sizeof(buffer) - 1
+           && (r = ssh_channel_read(channel, buffer + nbytes,
+                                    sizeof(buffer) - 1 - nbytes, 0)) > 0)
+      nbytes += r;
+  }
+  else
+    ftp_err(_("Couldn't run %s: %s\n"), prog, ssh_get_error(ftp->session));
+  free(cmd);
+
+  ssh_channel_send_eof(channel);
+  ssh_channel_close(channel);
+  ssh_channel_free(channel);
+
+  buffer[nbytes] = 0;
+  size_t len = strspn(buffer, "0123456789abcdef");
+  if (len == 0)
+    return NULL;
+  return xstrndup(buffer, len);
+}
+
+/* returns the checksums ssh_checksum() can compute, the server is asked
+ * once per session by hashing /dev/null with each of them
+ */
+unsigned int ssh_checksum_types(void)
+{
+  static const checksum_t types[] = { csSHA256, csMD5 };
+
+  if (ftp->ssh_hash_probed)
+    return ftp->xhash_types;
+  ftp->ssh_hash_probed = true;
+  ftp->xhash_types = 0;
+
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+  {
+    checksum cs;
+    char empty[CHECKSUM_HEXLEN + 1];
+
+    checksum_init(&cs, types[i]);
+    checksum_final(&cs, empty);
+
+    char* remote = ssh_checksum("/dev/null", types[i]);
+    if (remote && strcmp(remote, empty) == 0)
+      ftp->xhash_types |= types[i];
+    else
+      ftp_trace("%s does not work on the server\n", checksum_name(types[i]));
+    free(remote);
+  }
+
+  return ftp->xhash_types;
+}
+
 char* ssh_connected_user()
 {
   if (!ftp->session)
@@ -68,12 +68,14 @@ static void print_fxp_syntax(void)
 {
 	show_help(_("Transfers files between two remote servers."), "fxp [options] files",
 	  _("  -a, --append         append if destination exists\n"
+			"      --bg             run in the background, see 'jobs'\n"
 			"  -D, --delete-after   delete source file after successful transfer\n"
 			"      --dir-mask=GLOB  enter only directories matching GLOB pattern\n"
 			"      --dir-rx-mask=REGEXP\n"
 			"                       enter only directories matching REGEXP pattern\n"
 			"  -f, --force          overwrite existing destinations, never prompt\n"
-      "  -F, --force-newer    do not use cached information with --newer\n"
+      "  -F, --force-newer    ask the server for file times with --newer, unless\n"
+      "                       an MLSD listing of this session gave them\n"
 			"  -e, --skip-empty     skip empty files\n"
 			"  -H, --nohup          transfer files in background (nohup mode), quits yafc\n"
 			"  -i, --interactive    prompt before each transfer\n"
@@ -838,5 +840,11 @@ void cmd_fxp(int argc, char **argv)
 		fxpfiles(ftp->taglist, opt, fxp_output);
 
 	free(fxp_output);
+	if(fxp_target) {
+		Ftp *thisftp = ftp;
+		ftp_use(fxp_target);
+		ftp_mkpath_done();
+		ftp_use(thisftp);
+	}
 	gvInTransfer = false;
 }
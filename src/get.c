@@ -21,6 +21,8 @@
 #include "utils/modechange.h"
 #include "utils.h"
 
+#include <poll.h>
+
 #ifdef HAVE_REGEX_H
 # include <regex.h>
 #endif
@@ -48,6 +50,9 @@
 #define GET_CHGRP (1 << 19)
 #define GET_OUTPUT_FILE (1 << 20)  /* --output=FILE (else --output=DIR) */
 #define GET_SKIP_EMPTY (1 << 21)
+#define GET_PARALLEL (1 << 23)
+#define GET_SEGMENTS (1 << 24)
+#define GET_VERIFY (1 << 25)
 
 static bool get_quit = false;
 static bool get_owbatch = false;
@@ -56,6 +61,27 @@ static mode_change *cmod = 0;
 static gid_t group_change = -1;
 static bool get_skip_empty = false;
 
+/* number of extra connections to use with --parallel */
+static unsigned int get_parallel = 0;
+
+/* number of connections to use for each file with --segments */
+static unsigned int get_segments = 0;
+
+/* remote files to delete with --delete-after, deleted in batches with
+ * the DELE commands pipelined */
+static list *get_deletes = 0;
+
+/* a file queued for transfer by a parallel worker */
+typedef struct get_job_t {
+    rfile *fi;
+    unsigned int opt;
+    char *output;
+    char *destname;
+} get_job_t;
+
+/* list of get_job_t, non-zero while collecting files for --parallel */
+static list *get_jobs = 0;
+
 static char *get_glob_mask = 0;
 static char *get_dir_glob_mask = 0;
 #ifdef HAVE_REGEX
@@ -69,6 +95,7 @@ static void print_get_syntax(void)
 {
   show_help(_("Receives files from remote."), "get [options] files",
     _("  -a, --append         append if destination exists\n"
+      "      --bg             run in the background, see 'jobs'\n"
       "  -c, --chmod=PERM     change mode of transferred files to PERM;\n"
       "                       PERM can be permissions in its octal representation\n"
       "                       or of the form [ugoa]*[+-=][rwxXstugo]+ separated by commas\n"
@@ -79,7 +106,8 @@ static void print_get_syntax(void)
       "      --dir-rx-mask=REGEXP\n"
       "                       enter only directories matching REGEXP pattern\n"
       "  -f, --force          overwrite existing destinations, never prompt\n"
-      "  -F, --force-newer    do not use cached information with --newer\n"
+      "  -F, --force-newer    ask the server for file times with --newer, unless\n"
+      "                       an MLSD listing of this session gave them\n"
       "  -e, --skip-empty     skip empty files\n"
       "  -H, --nohup          transfer files in background (nohup mode), quits yafc\n"
       "  -i, --interactive    prompt before each transfer\n"
@@ -89,16 +117,20 @@ static void print_get_syntax(void)
       "  -n, --newer          get file if remote is newer than local file\n"
       "  -o, --output=DEST    store in local file/directory DEST\n"
       "  -p, --preserve       try to preserve file attributes and timestamps\n"
+      "      --parallel=N     transfer files over N extra connections at once;\n"
+      "                       existing files are handled as with --nohup\n"
       "  -P, --parents        append source path to destination\n"
       "  -q, --quiet          overrides --verbose\n"
       "  -r, --recursive      get directories recursively\n"
       "  -R, --resume         resume broken download (restart at eof)\n"
       "  -s, --skip-existing  skip file if destination exists\n"
+      "      --segments=N     get each file in N parts over N extra connections\n"
       "  -S, --stats[=NUM]    set stats transfer threshold; default is always\n"
       "  -t, --tagged         transfer tagged file(s)\n"
       "      --type=TYPE      specify transfer type, 'ascii' or 'binary'\n"
       "  -u, --unique         always store as unique local file\n"
-      "  -v, --verbose        explain what is being done\n"));
+      "  -v, --verbose        explain what is being done\n"
+      "      --verify         compare checksums with the server, retry on mismatch\n"));
 }
 
 static bool get_exclude_func(rfile *f)
@@ -110,12 +142,50 @@ static bool get_exclude_func(rfile *f)
     return false;
 }
 
+/* returns true if the directory F doesn't match --dir-mask or
+ * --dir-rx-mask, and shouldn't be descended into
+ */
+static bool get_dir_excluded(rfile *f)
+{
+    if(get_dir_glob_mask && fnmatch(get_dir_glob_mask, base_name_ptr(f->path),
+                                    FNM_EXTMATCH) == FNM_NOMATCH)
+        return true;
+#ifdef HAVE_REGEX
+    if(get_dir_rx_mask_set && regexec(&get_dir_rx_mask, base_name_ptr(f->path),
+                                      0, 0, 0) == REG_NOMATCH)
+        return true;
+#endif
+    return false;
+}
+
+/* reports the outcome of each DELE sent by get_flush_deletes() */
+static void get_delete_report(const char *path, bool removed, void *arg)
+{
+    char *sp = shortpath(path, 42, ftp->homedir);
+
+    if(removed)
+        fprintf(stderr, _("%s: deleted\n"), sp);
+    else
+        fprintf(stderr, _("error deleting '%s': %s\n"),
+                sp, ftp_getreply(false));
+    free(sp);
+}
+
+/* deletes the remote files queued for --delete-after */
+static void get_flush_deletes(void)
+{
+    if(get_deletes && list_numitem(get_deletes) > 0) {
+        ftp_unlink_list(get_deletes, get_delete_report, 0);
+        list_clear(get_deletes);
+    }
+}
+
 /* just gets the file SRC and store in local file DEST
  * doesn't parse any LIST output
  * returns 0 on success, else -1
  */
 static int do_the_get(const char *src, const char *dest,
-                      putmode_t how, unsigned opt)
+                      getmode_t how, unsigned opt)
 {
     char *fulldest;
     char *tmp;
@@ -138,15 +208,37 @@ static int do_the_get(const char *src, const char *dest,
         setproctitle("%s, get %s", ftp->url->hostname, src);
 #endif
 
-    int r = ftp_getfile(src, dest, how, type,
-                        test(opt, GET_VERBOSE)
-                        && !gvSighupReceived
-                        && !test(opt, GET_NOHUP) ? transfer : 0);
+    ftp_transfer_func hookf = test(opt, GET_VERBOSE)
+                              && !gvSighupReceived
+                              && !test(opt, GET_NOHUP)
+                              && !test(opt, GET_PARALLEL) ? transfer : 0;
+    int r, tries = 0;
+
+    ftp_verify(test(opt, GET_VERIFY));
+    while(true) {
+        /* the parallel workers don't own the connection pool */
+        if(test(opt, GET_SEGMENTS) && !test(opt, GET_PARALLEL)
+           && how == getNormal && type == tmBinary)
+            r = ftp_getfile_segmented(src, dest, get_segments, hookf);
+        else
+            r = ftp_getfile(src, dest, how, type, hookf);
 
-    if(r == 0 && (test(opt, GET_NOHUP) || gvSighupReceived)) {
-        fprintf(stderr, "%s [%sb of ",
-                src, human_size(ftp->ti.size));
-        fprintf(stderr, "%sb]\n", human_size(ftp->ti.total_size));
+        /* a file appended to or piped somewhere can't be got again */
+        if(r == 0 || !ftp->ti.checksum_mismatch || ++tries > 1
+           || how == getAppend || how == getPipe)
+            break;
+        fprintf(stderr, _("%s: getting file again\n"), src);
+        how = getNormal;
+    }
+    ftp_verify(false);
+
+    if(r == 0 && (test(opt, GET_NOHUP) || gvSighupReceived
+                  || (test(opt, GET_PARALLEL) && test(opt, GET_VERBOSE)))) {
+        /* print it in one go, parallel workers share stderr */
+        char *done = xstrdup(human_size(ftp->ti.size));
+        fprintf(stderr, "%s [%sb of %sb]\n",
+                src, done, human_size(ftp->ti.total_size));
+        free(done);
     }
     if(test(opt, GET_NOHUP)) {
         if(r == 0)
@@ -327,7 +419,7 @@ static int getfile(const rfile *fi, unsigned int opt,
                         _("Local file '%s' exists\nLocal: %lld bytes, %sRemote: %lld bytes, %sOverwrite?"),
                         sp,
                         (unsigned long long) sb.st_size, e ? e : "unknown date\n",
-                        ftp_filesize(fi->path), ctime(&ft));
+                        ftp_filesize(fi->path, false), ctime(&ft));
 								free(sp);
                 free(e);
                 if(a == ASKCANCEL) {
@@ -404,12 +496,11 @@ static int getfile(const rfile *fi, unsigned int opt,
                     dodel = true;
 
                 if(dodel) {
-                    ftp_unlink(fi->path);
-                    if(ftp->code == ctComplete)
-                        fprintf(stderr, _("%s: deleted\n"), sp);
-                    else
-                        fprintf(stderr, _("error deleting '%s': %s\n"),
-															  sp, ftp_getreply(false));
+                    if(!get_deletes)
+                        get_deletes = list_new((listfunc)free);
+                    list_additem(get_deletes, xstrdup(fi->path));
+                    if(list_numitem(get_deletes) >= FTP_PIPELINE_WINDOW)
+                        get_flush_deletes();
                 }
 								free(sp);
             }
@@ -423,6 +514,35 @@ static int getfile(const rfile *fi, unsigned int opt,
     return ret;
 }
 
+static void get_job_destroy(get_job_t *job)
+{
+    rfile_destroy(job->fi);
+    free(job->output);
+    free(job->destname);
+    free(job);
+}
+
+/* gets the file FI, or queues it for the parallel workers
+ * if we're collecting files for --parallel
+ * returns as getfile()
+ */
+static int getfile_or_queue(const rfile *fi, unsigned int opt,
+                            const char *output, const char *destname)
+{
+    get_job_t *job;
+
+    if(!get_jobs)
+        return getfile(fi, opt, output, destname);
+
+    job = (get_job_t *)xmalloc(sizeof(get_job_t));
+    job->fi = rfile_clone(fi);
+    job->opt = opt;
+    job->output = output ? xstrdup(output) : 0;
+    job->destname = xstrdup(destname);
+    list_additem(get_jobs, job);
+    return 0;
+}
+
 static bool get_batch = false;
 
 int get_sort_func(const void *a, const void *b)
@@ -446,6 +566,13 @@ static void getfiles(list *gl, unsigned int opt, const char *output)
 
     list_sort(gl, get_sort_func, false);
 
+    /* ask for the times --preserve and --newer need in one burst,
+     * instead of one MDTM per file */
+    if(test(opt, GET_PRESERVE))
+        ftp_filetime_prefetch(gl, true);
+    else if(test(opt, GET_NEWER))
+        ftp_filetime_prefetch(gl, test(opt, GET_FORCE_NEWER));
+
     li = gl->first;
     while(li && !get_quit) {
         fp = (rfile *)li->data;
@@ -453,6 +580,9 @@ static void getfiles(list *gl, unsigned int opt, const char *output)
         if(!ftp_connected())
             return;
 
+        /* connect the next data connection during this transfer */
+        ftp_lookahead(li->next != 0);
+
         if(gvSighupReceived) {
             if(!test(opt, GET_RESUME))
                 opt |= GET_UNIQUE;
@@ -490,7 +620,7 @@ static void getfiles(list *gl, unsigned int opt, const char *output)
             link_to_link__duh:
             if(test(opt, GET_NO_DEREFERENCE)) {
                 /* link the file, don't copy */
-                const int r = getfile(fp, opt, output, ofile);
+                const int r = getfile_or_queue(fp, opt, output, ofile);
                 transfer_nextfile(gl, &li, r == 0);
                 continue;
             }
@@ -507,7 +637,7 @@ static void getfiles(list *gl, unsigned int opt, const char *output)
             if(lnfp == 0) {
                 /* couldn't dereference the link, try to RETR it */
                 ftp_trace("unable to dereference link\n");
-                const int r = getfile(fp, opt, output, ofile);
+                const int r = getfile_or_queue(fp, opt, output, ofile);
                 transfer_nextfile(gl, &li, r == 0);
                 continue;
             }
@@ -538,15 +668,7 @@ static void getfiles(list *gl, unsigned int opt, const char *output)
                 list *rgl;
 
 
-                if((get_dir_glob_mask && fnmatch(get_dir_glob_mask,
-                                                 base_name_ptr(fp->path),
-                                                 FNM_EXTMATCH) == FNM_NOMATCH)
-#ifdef HAVE_REGEX
-                   || (get_dir_rx_mask_set && regexec(&get_dir_rx_mask,
-                                                      base_name_ptr(fp->path),
-                                                      0, 0, 0) == REG_NOMATCH)
-#endif
-                    )
+                if(get_dir_excluded(fp))
                     {
                     } else {
                         char *q_recurs_mask;
@@ -599,7 +721,7 @@ static void getfiles(list *gl, unsigned int opt, const char *output)
             transfer_nextfile(gl, &li, true);
             continue;
         }
-        const int r = getfile(fp, opt, output, ofile);
+        const int r = getfile_or_queue(fp, opt, output, ofile);
 
         transfer_nextfile(gl, &li, r == 0);
 
@@ -618,6 +740,251 @@ static void getfiles(list *gl, unsigned int opt, const char *output)
             }
         }
     }
+    ftp_lookahead(false);
+}
+
+/* runs in a forked child: reads indexes into JOBV from JOBFD and gets
+ * those files over the pooled connection WFTP, writing the index of each
+ * file done with to DONEFD, until there are no more jobs, then writes
+ * its stats to STATFD
+ */
+static void get_worker(Ftp *wftp, get_job_t **jobv, unsigned int njobs,
+                       int jobfd, int donefd, int statfd)
+{
+    unsigned int i;
+
+    /* we have our own copy of the parent's directory cache, use it
+     * instead of reading the directories again on this connection */
+    ftp_cache_destroy(wftp->cache);
+    wftp->cache = ftp->cache;
+    ftp_use(wftp);
+
+    stats_reset(gvStatsTransfer);
+    get_owbatch = get_delbatch = true;
+
+    while(!get_quit && !gvInterrupted && ftp_connected()
+          && read(jobfd, &i, sizeof(i)) == sizeof(i))
+    {
+        if(i >= njobs)
+            continue;
+        getfile(jobv[i]->fi, jobv[i]->opt, jobv[i]->output,
+                jobv[i]->destname);
+        if(write(donefd, &i, sizeof(i)) != sizeof(i))
+            break;
+    }
+    get_flush_deletes();
+
+    if(write(statfd, gvStatsTransfer, sizeof(Stats)) != sizeof(Stats))
+        perror("write()");
+    fflush(stdout);
+    _exit(0);
+}
+
+/* hands out the NJOBS jobs on JOBFD as the workers pick them up, and
+ * marks those the workers report on DONEFD in DONE, until all workers
+ * have exited
+ */
+static void get_parallel_dispatch(unsigned int njobs, int jobfd, int donefd,
+                                  bool *done)
+{
+    unsigned int next = 0;
+
+    while(true) {
+        struct pollfd pfds[2];
+        unsigned int i, npfds = 1;
+
+        /* stop handing out files when interrupted, the workers finish
+         * the files they are on and exit */
+        if(jobfd != -1 && (next == njobs || get_quit || gvInterrupted)) {
+            close(jobfd);
+            jobfd = -1;
+        }
+
+        pfds[0].fd = donefd;
+        pfds[0].events = POLLIN;
+        if(jobfd != -1) {
+            pfds[1].fd = jobfd;
+            pfds[1].events = POLLOUT;
+            npfds++;
+        }
+        if(poll(pfds, npfds, -1) == -1) {
+            if(errno == EINTR)
+                continue;
+            perror("poll()");
+            break;
+        }
+
+        if(npfds > 1 && pfds[1].revents) {
+            /* fails once all workers have exited */
+            if(write(jobfd, &next, sizeof(next)) != sizeof(next)) {
+                close(jobfd);
+                jobfd = -1;
+            } else
+                next++;
+        }
+
+        if(pfds[0].revents) {
+            /* end of file when all workers have exited */
+            if(read(donefd, &i, sizeof(i)) != sizeof(i))
+                break;
+            if(i < njobs)
+                done[i] = true;
+        }
+    }
+
+    if(jobfd != -1)
+        close(jobfd);
+}
+
+/* gets the files queued in get_jobs over up to get_parallel pooled
+ * connections, each connection is driven by a forked worker which
+ * picks the next file from a pipe when done with the previous one
+ *
+ * files the workers didn't get to, because their connections were
+ * lost, are transferred on this connection afterwards
+ */
+static void get_parallel_files(void)
+{
+    list *conns;
+    listitem *li;
+    get_job_t **jobv;
+    pid_t *pids;
+    bool *done;
+    int jobfds[2], donefds[2], statfds[2];
+    unsigned int i, njobs, nworkers = 0, nleft = 0;
+    Stats s;
+
+    njobs = list_numitem(get_jobs);
+    if(njobs == 0)
+        return;
+
+    /* the workers would inherit the queue and delete the files again */
+    get_flush_deletes();
+
+    jobv = (get_job_t **)xmalloc(njobs * sizeof(get_job_t *));
+    for(i=0, li=get_jobs->first; li; li=li->next)
+        jobv[i++] = (get_job_t *)li->data;
+
+    done = (bool *)xmalloc(njobs * sizeof(bool));
+    for(i = 0; i < njobs; i++)
+        done[i] = false;
+
+    conns = ftp_pool_acquire(min(get_parallel, njobs));
+    pids = (pid_t *)xmalloc((list_numitem(conns) + 1) * sizeof(pid_t));
+
+    if(list_numitem(conns) > 0) {
+        if(pipe(jobfds) != 0)
+            perror("pipe()");
+        else if(pipe(donefds) != 0) {
+            perror("pipe()");
+            close(jobfds[0]);
+            close(jobfds[1]);
+        } else if(pipe(statfds) != 0) {
+            perror("pipe()");
+            close(jobfds[0]);
+            close(jobfds[1]);
+            close(donefds[0]);
+            close(donefds[1]);
+        } else {
+            fflush(stdout);
+            fflush(stderr);
+            for(li=conns->first; li; li=li->next) {
+                pid_t pid = fork();
+                if(pid == 0) {
+                    close(jobfds[1]);
+                    close(donefds[0]);
+                    close(statfds[0]);
+                    get_worker((Ftp *)li->data, jobv, njobs,
+                               jobfds[0], donefds[1], statfds[1]);
+                }
+                if(pid == -1) {
+                    perror("fork()");
+                    break;
+                }
+                pids[nworkers++] = pid;
+            }
+            close(jobfds[0]);
+            close(donefds[1]);
+            close(statfds[1]);
+
+            if(nworkers > 0)
+                get_parallel_dispatch(njobs, jobfds[1], donefds[0], done);
+            else
+                close(jobfds[1]);
+            close(donefds[0]);
+
+            while(read(statfds[0], &s, sizeof(s)) == sizeof(s)) {
+                gvStatsTransfer->success += s.success;
+                gvStatsTransfer->skip += s.skip;
+                gvStatsTransfer->fail += s.fail;
+                gvStatsTransfer->size += s.size;
+            }
+            close(statfds[0]);
+
+            for(i=0; i < nworkers; i++)
+                waitpid(pids[i], 0, 0);
+        }
+    }
+
+    for(i = 0; i < njobs; i++) {
+        if(!done[i])
+            nleft++;
+    }
+    if(nworkers == 0)
+        ftp_err(_("Unable to open extra connections,"
+                  " transferring files one at a time\n"));
+    else if(nleft > 0 && !get_quit && !gvInterrupted)
+        ftp_err(_("Lost the extra connections, transferring the"
+                  " remaining %u files one at a time\n"), nleft);
+    if(nleft > 0) {
+        get_owbatch = get_delbatch = true;
+        for(i=0; i < njobs && !get_quit && !gvInterrupted; i++) {
+            if(!done[i])
+                getfile(jobv[i]->fi, jobv[i]->opt, jobv[i]->output,
+                        jobv[i]->destname);
+        }
+    }
+
+    free(done);
+    free(pids);
+    free(jobv);
+    list_free(conns);
+}
+
+/* gets the files in GL and the tagged files, if requested */
+static void get_all_files(list *gl, unsigned int opt, const char *output)
+{
+    if(test(opt, GET_PARALLEL))
+        get_jobs = list_new((listfunc)get_job_destroy);
+
+    /* list the whole tree at once, getfiles() then finds the
+     * directories in the cache */
+    if(test(opt, GET_RECURSIVE)) {
+        list *crawl_gl = list_new(0);
+        listitem *li;
+
+        for(li = gl->first; li; li = li->next)
+            list_additem(crawl_gl, li->data);
+        if(ftp->taglist && test(opt, GET_TAGGED)) {
+            for(li = ftp->taglist->first; li; li = li->next)
+                list_additem(crawl_gl, li->data);
+        }
+        ftp_crawl(crawl_gl, gvCrawlConnections ? gvCrawlConnections
+                  : get_parallel, get_dir_excluded);
+        list_free(crawl_gl);
+    }
+
+    if(list_numitem(gl))
+        getfiles(gl, opt, output);
+    if(ftp->taglist && test(opt, GET_TAGGED))
+        getfiles(ftp->taglist, opt, output);
+
+    if(get_jobs) {
+        get_parallel_files();
+        list_free(get_jobs);
+        get_jobs = 0;
+    }
+    get_flush_deletes();
 }
 
 void cmd_get(int argc, char **argv)
@@ -656,15 +1023,18 @@ void cmd_get(int argc, char **argv)
         {"nohup", no_argument, 0, 'H'},
         {"verbose", no_argument, 0, 'v'},
         {"preserve", no_argument, 0, 'p'},
+        {"parallel", required_argument, 0, '5'},
         {"parents", no_argument, 0, 'P'},
         {"quiet", no_argument, 0, 'q'},
         {"recursive", no_argument, 0, 'r'},
         {"resume", no_argument, 0, 'R'},
         {"skip-existing", no_argument, 0, 's'},
+        {"segments", required_argument, 0, '6'},
         {"stats", optional_argument, 0, 'S'},
         {"tagged", no_argument, 0, 't'},
         {"type", required_argument, 0, '1'},
         {"unique", no_argument, 0, 'u'},
+        {"verify", no_argument, 0, '7'},
         {"output", required_argument, 0, 'o'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0},
@@ -695,6 +1065,8 @@ void cmd_get(int argc, char **argv)
 #endif
 
     get_skip_empty = false;
+    get_parallel = 0;
+    get_segments = 0;
 
     optind = 0; /* force getopt() to re-initialize */
     while((c=getopt_long(argc, argv, "abHc:dDeio:fL:tnpPvqrRsuT:m:M:",
@@ -808,6 +1180,14 @@ void cmd_get(int argc, char **argv)
           case 'P':
             opt |= GET_PARENTS;
             break;
+          case '5': /* --parallel=N */
+            if(atoi(optarg) <= 0) {
+                printf(_("Invalid option argument --parallel=%s\n"), optarg);
+                return;
+            }
+            get_parallel = atoi(optarg);
+            opt |= GET_PARALLEL;
+            break;
           case 'H':
             opt |= GET_NOHUP;
             break;
@@ -820,6 +1200,17 @@ void cmd_get(int argc, char **argv)
           case 's':
             opt |= GET_SKIP_EXISTING;
             break;
+          case '6': /* --segments=N */
+            if(atoi(optarg) <= 0) {
+                printf(_("Invalid option argument --segments=%s\n"), optarg);
+                return;
+            }
+            get_segments = atoi(optarg);
+            opt |= GET_SEGMENTS;
+            break;
+          case '7': /* --verify */
+            opt |= GET_VERIFY;
+            break;
           case 'S':
             stat_thresh = optarg ? atoi(optarg) : 0;
             break;
@@ -886,11 +1277,23 @@ void cmd_get(int argc, char **argv)
         }
     }
 
+    if(test(opt, GET_VERIFY) && ftp_checksum_type() == csNone) {
+        fprintf(stderr, _("Server can't compute checksums,"
+                          " transfers will not be verified\n"));
+        opt &= ~GET_VERIFY;
+    }
+
     get_quit = false;
     get_batch = get_owbatch = get_delbatch = test(opt, GET_FORCE);
     if(test(opt, GET_FORCE))
         opt &= ~GET_INTERACTIVE;
 
+    /* the parallel workers can't prompt if the destination exists */
+    if(test(opt, GET_PARALLEL) && !test(opt, GET_FORCE)
+       && !test(opt, GET_RESUME) && !test(opt, GET_APPEND)
+       && !test(opt, GET_NEWER) && !test(opt, GET_SKIP_EXISTING))
+        opt |= GET_UNIQUE;
+
     if(get_output && !test(opt, GET_RECURSIVE) && list_numitem(gl) +
        (test(opt, GET_TAGGED) ? list_numitem(ftp->taglist) : 0) == 1)
         {
@@ -927,11 +1330,8 @@ void cmd_get(int argc, char **argv)
                 opt |= GET_UNIQUE;
             opt |= GET_FORCE;
 
-            if(list_numitem(gl))
-                getfiles(gl, opt, get_output);
+            get_all_files(gl, opt, get_output);
             rglob_destroy(gl);
-            if(ftp->taglist && test(opt, GET_TAGGED))
-                getfiles(ftp->taglist, opt, get_output);
             free(get_output);
 
             transfer_end_nohup();
@@ -949,11 +1349,8 @@ void cmd_get(int argc, char **argv)
         exit(0);
     }
 
-    if(list_numitem(gl))
-        getfiles(gl, opt, get_output);
+    get_all_files(gl, opt, get_output);
     rglob_destroy(gl);
-    if(ftp->taglist && test(opt, GET_TAGGED))
-        getfiles(ftp->taglist, opt, get_output);
     free(get_output);
     mode_free(cmod);
     cmod = 0;
@@ -18,6 +18,17 @@
 /* time (in seconds) before a cached directory times out, 0 == never */
 int gvCacheTimeout = 0;
 
+/* memory (in bytes) the directory cache may use, 0 == unlimited */
+size_t gvCacheMaxMemory = 64 * 1024 * 1024;
+
+/* time (in seconds) directories are kept in the persistent cache,
+ * 0 == no persistent cache */
+int gvPersistentCacheTTL = 0;
+
+/* number of extra connections used to list directory trees for
+ * recursive commands, 0 == list them one at a time */
+int gvCrawlConnections = 0;
+
 /* list of Ftp objects */
 list *gvFtpList = 0;
 
@@ -95,6 +106,7 @@ list *gvLocalTagList = 0; /* list of char* */
 
 /* default transfer type, binary (image) or ascii */
 transfer_mode_t gvDefaultType = tmBinary;
+int gvTransferBuffer = 0;
 
 /* used by bookmark --edit */
 char *gvEditor = 0;
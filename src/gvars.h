@@ -21,6 +21,17 @@
 /* time (in seconds) before a cached directory times out, 0 == never */
 extern int gvCacheTimeout;
 
+/* memory (in bytes) the directory cache may use, 0 == unlimited */
+extern size_t gvCacheMaxMemory;
+
+/* time (in seconds) directories are kept in the persistent cache,
+ * 0 == no persistent cache */
+extern int gvPersistentCacheTTL;
+
+/* number of extra connections used to list directory trees for
+ * recursive commands, 0 == list them one at a time */
+extern int gvCrawlConnections;
+
 /* list of Ftp objects */
 extern list *gvFtpList;
 
@@ -110,6 +121,9 @@ extern int gvHistoryMax;
 /* default transfer type, image or ascii */
 extern transfer_mode_t gvDefaultType;
 
+/* size of the data transfer buffers, 0 = adapt to the connection */
+extern int gvTransferBuffer;
+
 extern char *gvEditor;
 
 /* list of aliases */
@@ -0,0 +1,541 @@
+/*
+ * jobs.c -- background transfer jobs
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#include "syshdr.h"
+#include "ftp.h"
+#include "gvars.h"
+#include "strq.h"
+#include "args.h"
+#include "cmd.h"
+#include "commands.h"
+#include "transfer.h"
+#include "utils.h"
+#include "jobs.h"
+
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+# if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+#endif
+
+#define JOB_NAMELEN 256
+
+/* progress of a job, shared between the job and yafc */
+typedef struct job_status
+{
+	transfer_info ti;              /* current file, w/o the names */
+	char remote_name[JOB_NAMELEN];
+	char local_name[JOB_NAMELEN];
+	unsigned int files;            /* number of files started */
+} job_status;
+
+typedef struct job_t
+{
+	unsigned int id;
+	pid_t pid;
+	char *cmd;
+	job_status *st;    /* or 0 if progress isn't available */
+	FILE *logfp;       /* output of the job */
+	int status;        /* as returned by waitpid() */
+	bool done;
+} job_t;
+
+static list *jobs = 0;
+
+/* set in the job process */
+static bool job_child = false;
+static job_status *job_self = 0;
+
+static job_status *job_status_create(void)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+	void *p = mmap(0, sizeof(job_status), PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(p != MAP_FAILED)
+		return (job_status *)p;
+	ftp_trace("mmap: %s, job progress not available\n", strerror(errno));
+#endif
+	return 0;
+}
+
+static void job_destroy(job_t *jp)
+{
+	if(!jp)
+		return;
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+	if(jp->st)
+		munmap(jp->st, sizeof(job_status));
+#endif
+	if(jp->logfp)
+		fclose(jp->logfp);
+	free(jp->cmd);
+	free(jp);
+}
+
+static bool job_allowed(vfunc func)
+{
+	return func == cmd_get || func == cmd_put || func == cmd_fxp;
+}
+
+/* removes a trailing '&' argument or a --bg option from ARGS, if FUNC
+ * can be run in the background
+ * returns true if the command should be run as a background job
+ */
+bool job_strip_background(vfunc func, args_t *args)
+{
+	bool bg = false;
+	unsigned int i;
+
+	if(!job_allowed(func))
+		return false;
+
+	if(args->argc > 1 && strcmp(args->argv[args->argc - 1], "&") == 0) {
+		args_del(args, args->argc - 1, 1);
+		bg = true;
+	}
+	for(i=1; i<args->argc; i++) {
+		if(strcmp(args->argv[i], "--") == 0)
+			break;
+		if(strcmp(args->argv[i], "--bg") == 0) {
+			args_del(args, i--, 1);
+			bg = true;
+		}
+	}
+	return bg;
+}
+
+/* opens a connection of its own for the job, to replace the one in LI
+ * which is shared with yafc
+ * returns 0 on success, else -1
+ */
+static int job_reconnect(listitem *li, list *opened)
+{
+	Ftp *pftp = (Ftp *)li->data;
+	Ftp *jftp;
+
+	ftp_use(pftp);
+	if(!ftp_loggedin())
+		return 0;
+
+	jftp = ftp_pool_open();
+	if(!jftp) {
+		ftp_err(_("Unable to open a new connection to %s\n"),
+				pftp->url->hostname);
+		return -1;
+	}
+	jftp->verbosity = pftp->verbosity;
+
+	/* take over the directory cache and the tagged files */
+	ftp_cache_destroy(jftp->cache);
+	jftp->cache = pftp->cache;
+	pftp->cache = 0;
+	list_free(jftp->taglist);
+	jftp->taglist = pftp->taglist;
+	pftp->taglist = 0;
+
+	li->data = jftp;
+	list_additem(opened, jftp);
+	return 0;
+}
+
+/* runs in the forked job process, never returns */
+static void job_run(job_t *jp, vfunc func, int argc, char **argv)
+{
+	list *opened;
+	listitem *li;
+	Ftp *cur = ftp;
+	int fd;
+
+	/* a process group of its own keeps ^C at the prompt from
+	 * reaching the job */
+	setpgid(0, 0);
+	ftp_set_signal(SIGHUP, SIG_IGN);
+	ftp_set_signal(SIGINT, SIG_IGN);
+	ftp_set_signal(SIGQUIT, SIG_IGN);
+	ftp_set_signal(SIGTSTP, SIG_IGN);
+	gvJmpBufSet = false;
+
+	fd = open("/dev/null", O_RDONLY);
+	if(fd != -1) {
+		dup2(fd, STDIN_FILENO);
+		close(fd);
+	}
+	dup2(fileno(jp->logfp), STDOUT_FILENO);
+	dup2(fileno(jp->logfp), STDERR_FILENO);
+
+	job_child = true;
+	job_self = jp->st;
+
+	/* the control connections are shared with yafc, which goes on using
+	 * them, so log in again on new connections (an fxp job needs the
+	 * other end as well) and leave the inherited ones alone */
+	ftp_pool_detach();
+	opened = list_new(0);
+	for(li=gvFtpList->first; li; li=li->next) {
+		if(li->data != cur && func != cmd_fxp)
+			continue;
+		if(job_reconnect(li, opened) != 0)
+			_exit(1);
+	}
+	ftp_use((Ftp *)gvCurrentFtp->data);
+
+	/* only keep the output of the command itself */
+	fflush(stdout);
+	fflush(stderr);
+	if(ftruncate(STDOUT_FILENO, 0) == 0)
+		lseek(STDOUT_FILENO, 0, SEEK_SET);
+
+	func(argc, argv);
+
+	for(li=opened->first; li; li=li->next) {
+		ftp_use((Ftp *)li->data);
+		if(ftp_connected()) {
+			ftp_reply_timeout(10);
+			ftp_set_tmp_verbosity(vbNone);
+			ftp_cmd("QUIT");
+		}
+		ftp_close();
+	}
+	fflush(stdout);
+	fflush(stderr);
+	_exit(0);
+}
+
+/* runs FUNC with ARGV as a background job, in a forked process on
+ * connections of its own
+ */
+void job_start(vfunc func, int argc, char **argv)
+{
+	job_t *jp;
+	pid_t pid;
+
+#ifdef HAVE_LIBSSH
+	if(ftp->session) {
+		fprintf(stderr, _("Background jobs are not supported"
+						  " on SSH connections\n"));
+		return;
+	}
+#endif
+
+	jp = (job_t *)xmalloc(sizeof(job_t));
+	jp->cmd = args_cat(argc, argv, 0);
+	jp->logfp = tmpfile();
+	if(!jp->logfp) {
+		perror("tmpfile()");
+		job_destroy(jp);
+		return;
+	}
+	jp->st = job_status_create();
+
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if(pid == -1) {
+		perror("fork()");
+		job_destroy(jp);
+		return;
+	}
+	if(pid == 0)
+		job_run(jp, func, argc, argv);
+
+	if(!jobs)
+		jobs = list_new((listfunc)job_destroy);
+	jp->pid = pid;
+	jp->id = list_numitem(jobs)
+		? ((job_t *)jobs->last->data)->id + 1 : 1;
+	list_additem(jobs, jp);
+	printf("[%u] %u\n", jp->id, (unsigned)pid);
+}
+
+/* called from transfer() with the progress of the current file
+ * returns true in a background job, where the progress is recorded
+ * for the jobs command instead of printed
+ */
+bool job_report(transfer_info *ti)
+{
+	job_status *st = job_self;
+
+	if(!job_child)
+		return false;
+	if(!st || !ti)
+		return true;
+
+	if(ti->begin)
+		st->files++;
+	st->ti = *ti;
+	st->ti.remote_name = st->ti.local_name = 0;
+	strlcpy(st->remote_name, ti->remote_name ? ti->remote_name : "",
+			sizeof(st->remote_name));
+	strlcpy(st->local_name, ti->local_name ? ti->local_name : "",
+			sizeof(st->local_name));
+	return true;
+}
+
+/* makes a private copy of the progress of JP in ST, with TI's names
+ * pointing into it
+ * returns false if no transfer has started yet
+ */
+static bool job_progress(job_t *jp, job_status *st)
+{
+	if(!jp->st || jp->st->files == 0)
+		return false;
+	*st = *jp->st;
+	st->remote_name[JOB_NAMELEN - 1] = 0;
+	st->local_name[JOB_NAMELEN - 1] = 0;
+	st->ti.remote_name = st->remote_name;
+	st->ti.local_name = st->local_name;
+	return true;
+}
+
+/* collects the exit status of finished jobs, waits for JP if given */
+static void job_reap(job_t *jp)
+{
+	listitem *li;
+
+	if(jp && !jp->done) {
+		while(waitpid(jp->pid, &jp->status, 0) == -1 && errno == EINTR)
+			;
+		jp->done = true;
+	}
+
+	if(!jobs)
+		return;
+	for(li=jobs->first; li; li=li->next) {
+		job_t *j = (job_t *)li->data;
+		if(!j->done && waitpid(j->pid, &j->status, WNOHANG) == j->pid)
+			j->done = true;
+	}
+}
+
+static void job_print(job_t *jp)
+{
+	job_status st;
+
+	printf("[%u]  ", jp->id);
+	if(!jp->done)
+		printf("%-10s", _("Running"));
+	else if(WIFSIGNALED(jp->status))
+		printf("%-10s", _("Killed"));
+	else if(WIFEXITED(jp->status) && WEXITSTATUS(jp->status) != 0)
+		printf("%-10s", _("Failed"));
+	else
+		printf("%-10s", _("Done"));
+	printf("%s\n", jp->cmd);
+
+	if(jp->done || !job_progress(jp, &st))
+		return;
+
+	printf("      %s: %sB", st.ti.remote_name, human_size(st.ti.size));
+	if(st.ti.total_size != -1L && st.ti.total_size >= st.ti.size)
+		printf(_(" of %sB (%.1f%%)"), human_size(st.ti.total_size),
+			   (double)100*st.ti.size / (st.ti.total_size + (st.ti.total_size ? 0 : 1)));
+	if(st.files > 1)
+		printf(_(", file %u"), st.files);
+	printf("\n");
+}
+
+static int job_search(const job_t *jp, const job_t *arg)
+{
+	return jp != arg;
+}
+
+/* prints the outcome of the finished job JP and its output, and
+ * forgets about it
+ */
+static void job_finish(job_t *jp)
+{
+	char buf[4096];
+	size_t n;
+	listitem *li;
+
+	job_print(jp);
+	fflush(stdout);
+	rewind(jp->logfp);
+	while((n = fread(buf, 1, sizeof(buf), jp->logfp)) > 0)
+		fwrite(buf, 1, n, stdout);
+	fflush(stdout);
+
+	li = list_search(jobs, (listsearchfunc)job_search, jp);
+	if(li)
+		list_delitem(jobs, li);
+}
+
+/* reports background jobs that have finished since last time, called
+ * before the prompt is printed
+ */
+void job_check(void)
+{
+	listitem *li, *next;
+
+	if(!jobs)
+		return;
+	job_reap(0);
+	for(li=jobs->first; li; li=next) {
+		next = li->next;
+		if(((job_t *)li->data)->done)
+			job_finish((job_t *)li->data);
+	}
+}
+
+/* terminates any running jobs, called when yafc exits */
+void job_kill_all(void)
+{
+	listitem *li;
+
+	if(!jobs)
+		return;
+	for(li=jobs->first; li; li=li->next) {
+		job_t *jp = (job_t *)li->data;
+		if(!jp->done) {
+			kill(jp->pid, SIGTERM);
+			job_reap(jp);
+		}
+	}
+	list_free(jobs);
+	jobs = 0;
+}
+
+static job_t *job_find(const char *str)
+{
+	listitem *li;
+	unsigned int id;
+	char *e;
+
+	if(!jobs || list_numitem(jobs) == 0) {
+		fprintf(stderr, _("No background jobs\n"));
+		return 0;
+	}
+	if(!str)
+		return (job_t *)jobs->last->data;
+
+	if(*str == '%')
+		str++;
+	id = strtoul(str, &e, 10);
+	if(*str && !*e) {
+		for(li=jobs->first; li; li=li->next) {
+			if(((job_t *)li->data)->id == id)
+				return (job_t *)li->data;
+		}
+	}
+	fprintf(stderr, _("%s: no such job\n"), str);
+	return 0;
+}
+
+/* waits for JP to finish, showing its progress as the foreground
+ * transfers do
+ */
+static void job_wait(job_t *jp)
+{
+	job_status st;
+
+	printf("%s\n", jp->cmd);
+	while(!jp->done && !gvInterrupted) {
+		if(waitpid(jp->pid, &jp->status, WNOHANG) == jp->pid) {
+			jp->done = true;
+			break;
+		}
+		if(job_progress(jp, &st)) {
+			st.ti.begin = st.ti.finished = false;
+			transfer(&st.ti);
+		}
+		sleep(1);
+	}
+	transfer(0);
+	if(jp->done)
+		job_finish(jp);
+}
+
+void cmd_jobs(int argc, char **argv)
+{
+	int c, i;
+	bool killjobs = false;
+	struct option longopts[] = {
+		{"kill", no_argument, 0, 'k'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	optind = 0;
+	while((c = getopt_long(argc, argv, "kh", longopts, 0)) != EOF) {
+		switch(c) {
+		  case 'k':
+			killjobs = true;
+			break;
+		  case 'h':
+			show_help(_("List background jobs."), "jobs [options] [job...]",
+			  _("Background jobs are started by ending a get, put or fxp"
+				" command with '&',\n"
+				"or by giving it the --bg option\n"
+				"  -k, --kill           terminate the given jobs\n"));
+			return;
+		  case '?':
+			return;
+		}
+	}
+
+	if(killjobs) {
+		minargs(optind);
+		for(i=optind; i<argc; i++) {
+			job_t *jp = job_find(argv[i]);
+			if(jp && !jp->done)
+				kill(jp->pid, SIGTERM);
+		}
+		return;
+	}
+
+	job_reap(0);
+	if(argc > optind) {
+		for(i=optind; i<argc; i++) {
+			job_t *jp = job_find(argv[i]);
+			if(jp && jp->done)
+				job_finish(jp);
+			else if(jp)
+				job_print(jp);
+		}
+	} else if(jobs) {
+		listitem *li, *next;
+		for(li=jobs->first; li; li=next) {
+			job_t *jp = (job_t *)li->data;
+			next = li->next;
+			if(jp->done)
+				job_finish(jp);
+			else
+				job_print(jp);
+		}
+	}
+}
+
+void cmd_fg(int argc, char **argv)
+{
+	job_t *jp;
+
+	OPT_HELP_NEW(_("Wait for a background job to finish."), "fg [options] [job]",
+	  _("Without argument, wait for the most recently started job\n"));
+	maxargs(optind);
+
+	jp = job_find(argc > optind ? argv[optind] : 0);
+	if(jp)
+		job_wait(jp);
+}
+
+void cmd_wait(int argc, char **argv)
+{
+	OPT_HELP_NEW(_("Wait for all background jobs to finish."), "wait [options]", NULL);
+	maxargs(optind - 1);
+
+	while(jobs && jobs->first && !gvInterrupted)
+		job_wait((job_t *)jobs->first->data);
+}
@@ -0,0 +1,26 @@
+/*
+ * jobs.h -- background transfer jobs
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#ifndef _jobs_h_included
+#define _jobs_h_included
+
+#include "args.h"
+#include "cmd.h"
+#include "ftp.h"
+
+bool job_strip_background(vfunc func, args_t *args);
+void job_start(vfunc func, int argc, char **argv);
+bool job_report(transfer_info *ti);
+void job_check(void);
+void job_kill_all(void);
+
+#endif
@@ -13,6 +13,7 @@
 #include "syshdr.h"
 #include "strq.h"
 #include "linklist.h"
+#include "strset.h"
 #include "lglob.h"
 #include "gvars.h"
 
@@ -32,6 +33,13 @@
 #  include <ndir.h>
 # endif
 #endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+
+#if defined(HAVE_FSTATAT) && defined(HAVE_FDOPENDIR)
+# define USE_AT_FUNCS 1
+#endif
 
 list *lglob_create(void)
 {
@@ -64,6 +72,8 @@ int lglob_glob(list *gl, const char *mask, bool ignore_multiples,
 	DIR *dp;
 	char *directory;
 	bool added = false, found = false;
+	strset *paths = 0;
+	listitem *li;
 
 	directory = base_dir_xptr(mask);
 
@@ -78,6 +88,12 @@ int lglob_glob(list *gl, const char *mask, bool ignore_multiples,
 		return -1;
 	}
 
+	if(ignore_multiples) {
+		paths = strset_new();
+		for(li = gl->first; li; li = li->next)
+			strset_add(paths, (char *)li->data);
+	}
+
 	while((de = readdir(dp)) != 0) {
 		char *path;
 
@@ -86,6 +102,7 @@ int lglob_glob(list *gl, const char *mask, bool ignore_multiples,
       ftp_err(_("Failed to allocate memory.\n"));
       closedir(dp);
       free(tmp);
+      strset_free(paths);
       return -1;
     }
 
@@ -93,8 +110,7 @@ int lglob_glob(list *gl, const char *mask, bool ignore_multiples,
 			if(!(exclude_func && exclude_func(path))) {
 				char* p = path_absolute(path, tmp, gvLocalHomeDir);
         const bool ignore_item =
-					(ignore_multiples &&
-					 (list_search(gl, (listsearchfunc)strcmp, p) != 0));
+					(ignore_multiples && !strset_add(paths, p));
 
 				if(!ignore_item) {
 					list_additem(gl, p);
@@ -108,6 +124,7 @@ int lglob_glob(list *gl, const char *mask, bool ignore_multiples,
 		free(path);
 	}
   free(tmp);
+	strset_free(paths);
 	closedir(dp);
 
 	if(!found) {
@@ -117,3 +134,76 @@ int lglob_glob(list *gl, const char *mask, bool ignore_multiples,
 
 	return added ? 0 : -1;
 }
+
+lfile *lfile_create(const char *path)
+{
+	lfile *lf = (lfile *)xmalloc(sizeof(lfile));
+	lf->path = xstrdup(path);
+	return lf;
+}
+
+void lfile_destroy(lfile *lf)
+{
+	if(!lf)
+		return;
+	free(lf->path);
+	free(lf);
+}
+
+/* returns a list of lfiles for the entries in directory DIR, except
+ * . and .., in directory order, or 0 if DIR can't be read
+ *
+ * subdirectories are recognized by d_type where available and aren't
+ * stat'ed, other entries are stat'ed relative to DIR; the paths are
+ * DIR/name
+ */
+list *lglob_dir(const char *dir)
+{
+	struct dirent *de;
+	DIR *dp;
+	list *gl;
+
+#ifdef USE_AT_FUNCS
+	int fd = open(dir, O_RDONLY);
+	dp = fd == -1 ? 0 : fdopendir(fd);
+	if(!dp && fd != -1)
+		close(fd);
+#else
+	dp = opendir(dir);
+#endif
+	if(!dp) {
+		ftp_err("Unable to read directory %s\n", dir);
+		return 0;
+	}
+
+	gl = list_new((listfunc)lfile_destroy);
+	while((de = readdir(dp)) != 0) {
+		lfile *lf;
+
+		if(strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		lf = (lfile *)xmalloc(sizeof(lfile));
+		if(asprintf(&lf->path, "%s/%s", dir, de->d_name) == -1) {
+			ftp_err(_("Failed to allocate memory.\n"));
+			free(lf);
+			break;
+		}
+		list_additem(gl, lf);
+
+#ifdef HAVE_STRUCT_DIRENT_D_TYPE
+		if(de->d_type == DT_DIR) {
+			lf->sb.st_mode = S_IFDIR;
+			continue;
+		}
+#endif
+#ifdef USE_AT_FUNCS
+		lf->has_stat = (fstatat(dirfd(dp), de->d_name, &lf->sb, 0) == 0);
+#else
+		lf->has_stat = (stat(lf->path, &lf->sb) == 0);
+#endif
+	}
+	closedir(dp);
+
+	return gl;
+}
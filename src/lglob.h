@@ -13,14 +13,27 @@
 #ifndef _lglob_h_included
 #define _lglob_h_included
 
+#include "syshdr.h"
 #include "linklist.h"
 
 typedef bool (*lglobfunc)(char *f);
 
+/* a local file found by lglob_dir() */
+typedef struct lfile
+{
+	char *path;
+	struct stat sb;
+	bool has_stat;    /* if false, only sb.st_mode may be set */
+} lfile;
+
 list *lglob_create(void);
 void lglob_destroy(list *gl);
 bool lglob_exclude_dotdirs(char *f);
 int lglob_glob(list *gl, const char *mask, bool ignore_multiples,
 			   lglobfunc exclude_func);
 
+lfile *lfile_create(const char *path);
+void lfile_destroy(lfile *lf);
+list *lglob_dir(const char *dir);
+
 #endif
@@ -104,38 +104,61 @@ int list_numitem(list *lp)
 	return lp->numitem;
 }
 
-static void list_swap(list *lp, listitem *a, listitem *b)
+/* merges the sorted runs A[LO..MID) and A[MID..HI) into B
+ * an item is taken from the second run only if it sorts strictly
+ * before the first one's, which keeps the sort stable
+ */
+static void merge_runs(void **a, void **b, int lo, int mid, int hi,
+					   listsortfunc cmp, bool reverse)
 {
-	void *tmp;
-
-	if(!a || !b || a->data == b->data)
-		return;
-
-	tmp = a->data;
-	a->data = b->data;
-	b->data = tmp;
+	int i = lo, j = mid, k = lo;
+
+	while(i < mid && j < hi) {
+		int c = cmp(a[i], a[j]);
+		if(reverse ? c < 0 : c > 0)
+			b[k++] = a[j++];
+		else
+			b[k++] = a[i++];
+	}
+	while(i < mid)
+		b[k++] = a[i++];
+	while(j < hi)
+		b[k++] = a[j++];
 }
 
-/* simple bubble-sort */
+/* stable bottom-up merge sort
+ * the list items stay in place, only their data is reordered
+ */
 void list_sort(list *lp, listsortfunc cmp, bool reverse)
 {
-	listitem *li, *last = 0;
-	bool swapped = true;
-
-	while(swapped) {
-		swapped = false;
-		for(li=lp->first; li && li->next; li=li->next) {
-			if(li->next == last) {
-				last = li;
-				break;
-			}
-			int c = cmp(li->data, li->next->data);
-			if(reverse ? c < 0  : c > 0) {
-				list_swap(lp, li, li->next);
-				swapped = true;
-			}
+	void **a, **b, **tmp;
+	listitem *li;
+	int n, i, width;
+
+	n = list_numitem(lp);
+	if(n < 2)
+		return;
+
+	a = (void **)xmalloc(n * sizeof(void *));
+	b = (void **)xmalloc(n * sizeof(void *));
+	for(i=0, li=lp->first; li; li=li->next)
+		a[i++] = li->data;
+
+	for(width=1; width < n; width *= 2) {
+		for(i=0; i < n; i += 2*width) {
+			int mid = i + width < n ? i + width : n;
+			int hi = i + 2*width < n ? i + 2*width : n;
+			merge_runs(a, b, i, mid, hi, cmp, reverse);
 		}
+		tmp = a;
+		a = b;
+		b = tmp;
 	}
+
+	for(i=0, li=lp->first; li; li=li->next)
+		li->data = a[i++];
+	free(a);
+	free(b);
 }
 
 void list_removeitem(list *lp, listitem *lip)
@@ -0,0 +1,93 @@
+/*
+ * strset.c -- set of strings
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#include "syshdr.h"
+
+#include "strset.h"
+#include "xmalloc.h"
+
+struct strset {
+	const char **items;   /* open addressing, size is a power of 2 */
+	unsigned int size;
+	unsigned int count;
+};
+
+static unsigned int strset_hash(const char *str)
+{
+	unsigned int h = 2166136261U;   /* FNV-1a */
+
+	while(*str) {
+		h ^= (unsigned char)*str++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/* returns the slot of STR, or the empty slot where it belongs */
+static unsigned int strset_slot(const strset *set, const char *str)
+{
+	unsigned int i = strset_hash(str) & (set->size - 1);
+
+	while(set->items[i] && strcmp(set->items[i], str) != 0)
+		i = (i + 1) & (set->size - 1);
+	return i;
+}
+
+static void strset_grow(strset *set)
+{
+	const char **items = set->items;
+	unsigned int size = set->size;
+	unsigned int i;
+
+	set->size *= 2;
+	set->items = (const char **)xmalloc(set->size * sizeof(char *));
+	for(i = 0; i < size; i++) {
+		if(items[i])
+			set->items[strset_slot(set, items[i])] = items[i];
+	}
+	free(items);
+}
+
+strset *strset_new(void)
+{
+	strset *set = (strset *)xmalloc(sizeof(strset));
+
+	set->size = 64;
+	set->items = (const char **)xmalloc(set->size * sizeof(char *));
+	return set;
+}
+
+void strset_free(strset *set)
+{
+	if(!set)
+		return;
+	free(set->items);
+	free(set);
+}
+
+bool strset_contains(const strset *set, const char *str)
+{
+	return set->items[strset_slot(set, str)] != 0;
+}
+
+/* adds STR to SET, returns false if it already was in the set */
+bool strset_add(strset *set, const char *str)
+{
+	unsigned int i = strset_slot(set, str);
+
+	if(set->items[i])
+		return false;
+	set->items[i] = str;
+	if(2 * ++set->count > set->size)
+		strset_grow(set);
+	return true;
+}
@@ -0,0 +1,26 @@
+/*
+ * strset.h -- set of strings
+ *
+ * Yet Another FTP Client
+ * Copyright (C) 1998-2001, Martin Hedenfalk <mhe@stacken.kth.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version. See COPYING for more details.
+ */
+
+#ifndef _strset_h_included
+#define _strset_h_included
+
+#include <stdbool.h>
+
+/* the strings aren't copied, they must stay valid while in the set */
+typedef struct strset strset;
+
+strset *strset_new(void);
+void strset_free(strset *set);
+bool strset_contains(const strset *set, const char *str);
+bool strset_add(strset *set, const char *str);
+
+#endif
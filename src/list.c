@@ -89,8 +89,8 @@ static int print_filename(rfile *fi, unsigned opt, bool doclr)
 {
 	int len = 0;
 
-	if(doclr && fi->color)
-		printf("%s", fi->color);
+	if(doclr)
+		printf("%s", rfile_color(fi));
 	if(test(opt, LS_LITERAL))
 		len += printf("%s", base_name_ptr(fi->path));
 	else {
@@ -100,7 +100,7 @@ static int print_filename(rfile *fi, unsigned opt, bool doclr)
 		len += printf("%s", e);
 		free(e);
 	}
-	if(doclr && fi->color)
+	if(doclr)
 		printf("%s", endcolor());
 	if(test(opt, LS_CLASSIFY)) {
 		char cc = rfile_classchar(fi);
@@ -399,8 +399,12 @@ static void lsfiles(list *gl, unsigned opt)
 
 	ls_all(gl, opt, doclr);
 
-	if(test(opt, LS_RECURSIVE))
+	if(test(opt, LS_RECURSIVE)) {
+		/* list the whole tree at once, ls_recursive() then finds the
+		 * directories in the cache */
+		ftp_crawl(gl, gvCrawlConnections, dontlist);
 		ls_recursive(gl, opt, doclr);
+	}
 }
 
 static bool contains_dotfiles(int optind, int argc, char **argv)
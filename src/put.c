@@ -33,6 +33,7 @@
 #define PUT_VERBOSE 32
 #define PUT_FORCE 64
 #define PUT_FORCE_NEWER (1 << 18)
+#define PUT_VERIFY (1 << 19)
 #define PUT_OUTPUT_FILE 128  /* --output=FILE (else --output=DIR) */
 #define PUT_UNIQUE 256
 #define PUT_DELETE_AFTER 512
@@ -64,13 +65,15 @@ static void print_put_syntax(void)
 {
 	show_help(_("Send files to remote."), "put [options] file(s) (can include wildcards)",
 	  _("  -a, --append         append if destination file exists\n"
+			"      --bg             run in the background, see 'jobs'\n"
 			"  -D, --delete-after   delete local file after successful transfer\n"
 			"      --dir-mask=GLOB  enter only directories matching GLOB pattern\n"
 			"      --dir-rx-mask=REGEXP\n"
 			"                       enter only directories matching REGEXP pattern\n"
 			"  -e, --skip-empty     skip empty files\n"
 			"  -f, --force          overwrite existing destinations, never prompt\n"
-      "  -F, --force-newer    do not use cached information with --newer\n"
+      "  -F, --force-newer    ask the server for file times with --newer, unless\n"
+      "                       an MLSD listing of this session gave them\n"
 			"  -H, --nohup          transfer files in background (nohup mode), quits yafc\n"
 			"  -i, --interactive    prompt before transferring each file\n"
 			"  -L, --logfile=FILE   specify other logfile used by --nohup\n"
@@ -88,6 +91,7 @@ static void print_put_syntax(void)
 			"  -t, --tagged         transfer (locally) tagged file(s)\n"
 			"      --type=TYPE      specify transfer type, 'ascii' or 'binary'\n"
 			"  -v, --verbose        explain what is being done\n"
+			"      --verify         compare checksums with the server, retry on mismatch\n"
 			"  -u, --unique         store in unique filename (if server supports STOU)\n"));
 }
 
@@ -107,7 +111,7 @@ static bool put_exclude_func(char *path)
 static int do_the_put(const char *src, const char *dest,
 					  putmode_t how, unsigned opt)
 {
-	int r;
+	int r, tries = 0;
 	transfer_mode_t type;
 
 	if(test(opt, PUT_NOHUP))
@@ -123,8 +127,19 @@ static int do_the_put(const char *src, const char *dest,
 	if(gvUseEnvString && ftp_connected())
 		setproctitle("%s, put %s", ftp->url->hostname, src);
 #endif
-	r = ftp_putfile(src, dest, how, type,
-					test(opt, PUT_VERBOSE) ? transfer : 0);
+	ftp_verify(test(opt, PUT_VERIFY));
+	while(true) {
+		r = ftp_putfile(src, dest, how, type,
+						test(opt, PUT_VERBOSE) ? transfer : 0);
+
+		/* another unique file would be left next to the bad one */
+		if(r == 0 || !ftp->ti.checksum_mismatch || ++tries > 1
+		   || how == putUnique)
+			break;
+		fprintf(stderr, _("%s: sending file again\n"), src);
+		how = putNormal;
+	}
+	ftp_verify(false);
 #if 0 && (defined(HAVE_SETPROCTITLE) || defined(linux))
 	if(gvUseEnvString && ftp_connected())
 		setproctitle("%s", ftp->url->hostname);
@@ -250,7 +265,7 @@ static void putfile(const char *path, struct stat *sb,
 						_("Remote file '%s' exists\nLocal: %lld bytes, %sRemote: %lld bytes, %sOverwrite?"),
 						sp,
 						(unsigned long long) sb->st_size, e ? e : "unknown size",
-						ftp_filesize(f->path), ctime(&ft));
+						ftp_filesize(f->path, false), ctime(&ft));
 				free(sp);
 				free(e);
 				if(a == ASKCANCEL) {
@@ -323,17 +338,18 @@ static void putfile(const char *path, struct stat *sb,
 
 static int put_sort_func(const void *a, const void *b)
 {
-   bool tfa = transfer_first((char *)a);
-   bool tfb = transfer_first((char *)b);
+   bool tfa = transfer_first(((const lfile *)a)->path);
+   bool tfb = transfer_first(((const lfile *)b)->path);
 
    if(tfa)
 	  return tfb ? 0 : -1;
    return tfb ? 1 : 0;
 }
 
+/* puts the files in GL, a list of lfiles */
 static void putfiles(list *gl, unsigned opt, const char *output)
 {
-	struct stat sb;
+	struct stat *sb;
 	char *path = 0;
 	const char *file;
 	listitem *li;
@@ -345,13 +361,17 @@ static void putfiles(list *gl, unsigned opt, const char *output)
 		if(!ftp_connected())
 			return;
 
+		/* connect the next data connection during this transfer */
+		ftp_lookahead(li->next != 0);
+
 		if(gvSighupReceived) {
 			if(!test(opt, PUT_RESUME))
 				opt |= PUT_UNIQUE;
 			opt |= PUT_FORCE;
 		}
 
-		path = (char *)li->data;
+		path = ((lfile *)li->data)->path;
+		sb = &((lfile *)li->data)->sb;
 		file = base_name_ptr(path);
 
 		if(strcmp(file, ".") == 0 || strcmp(file, "..") == 0)
@@ -376,15 +396,18 @@ static void putfiles(list *gl, unsigned opt, const char *output)
 			/* else a==ASKYES */
 		}
 
-		if(stat(path, &sb) != 0) {
-			perror(path);
-			continue;
+		/* directories read by lglob_dir() may only have st_mode */
+		if(!((lfile *)li->data)->has_stat && !S_ISDIR(sb->st_mode)) {
+			if(stat(path, sb) != 0) {
+				perror(path);
+				continue;
+			}
+			((lfile *)li->data)->has_stat = true;
 		}
 
-		if(S_ISDIR(sb.st_mode)) {
+		if(S_ISDIR(sb->st_mode)) {
 			if(test(opt, PUT_RECURSIVE)) {
 				char *recurs_output;
-				char *recurs_mask;
 				list *rgl;
 
 				if((put_dir_glob_mask
@@ -412,17 +435,10 @@ static void putfiles(list *gl, unsigned opt, const char *output)
 						} else
 							recurs_output = xstrdup(output ? output : ".");
 
-						if (asprintf(&recurs_mask, "%s/*", path) == -1)
-            {
-              fprintf(stderr, _("Failed to allocate memory.\n"));
-              continue;
-            }
-						rgl = lglob_create();
-						lglob_glob(rgl, recurs_mask, true, put_exclude_func);
-						free(recurs_mask);
-
-						if(list_numitem(rgl) > 0)
+						rgl = lglob_dir(path);
+						if(rgl && list_numitem(rgl) > 0)
 							putfiles(rgl, opt, recurs_output);
+						list_free(rgl);
 						free(recurs_output);
 					}
 			} else {
@@ -432,13 +448,15 @@ static void putfiles(list *gl, unsigned opt, const char *output)
 			}
 			continue;
 		}
-		if(!S_ISREG(sb.st_mode)) {
+		if(!S_ISREG(sb->st_mode)) {
 			char* sp = shortpath(path, 42, gvLocalHomeDir);
 			fprintf(stderr, _("%s: not a regular file\n"), sp);
 			free(sp);
 			continue;
 		}
-		putfile(path, &sb, opt, output);
+		if(put_skip_empty && sb->st_size == 0)
+			continue;
+		putfile(path, sb, opt, output);
 
 		if(gvInterrupted) {
 			gvInterrupted = false;
@@ -455,6 +473,19 @@ static void putfiles(list *gl, unsigned opt, const char *output)
 			}
 		}
 	}
+	ftp_lookahead(false);
+}
+
+/* puts the files in GL, a list of paths */
+static void putpaths(list *gl, unsigned opt, const char *output)
+{
+	list *files = list_new((listfunc)lfile_destroy);
+	listitem *li;
+
+	for(li = gl->first; li; li = li->next)
+		list_additem(files, lfile_create((char *)li->data));
+	putfiles(files, opt, output);
+	list_free(files);
 }
 
 /* store a local file on remote server */
@@ -500,6 +531,7 @@ void cmd_put(int argc, char **argv)
 		{"type", required_argument, 0, '1'},
 		{"verbose", no_argument, 0, 'v'},
 		{"unique", no_argument, 0, 'u'},
+		{"verify", no_argument, 0, '5'},
 		{"help", no_argument, 0, 'h'},
 		{0, 0, 0, 0},
 	};
@@ -645,6 +677,9 @@ void cmd_put(int argc, char **argv)
 				return;
 			}
 			break;
+		  case '5': /* --verify */
+			opt |= PUT_VERIFY;
+			break;
 		  case 'p':
 			opt |= PUT_PRESERVE;
 			break;
@@ -693,8 +728,11 @@ void cmd_put(int argc, char **argv)
 		}
 	}
 
-	free(ftp->last_mkpath);
-	ftp->last_mkpath = 0;
+	if(test(opt, PUT_VERIFY) && ftp_checksum_type() == csNone) {
+		fprintf(stderr, _("Server can't compute checksums,"
+						  " transfers will not be verified\n"));
+		opt &= ~PUT_VERIFY;
+	}
 
 	put_quit = false;
 	put_batch = put_owbatch = put_delbatch = test(opt, PUT_FORCE);
@@ -732,10 +770,10 @@ void cmd_put(int argc, char **argv)
 				opt |= PUT_UNIQUE;
 			opt |= PUT_FORCE;
 
-			putfiles(gl, opt, put_output);
+			putpaths(gl, opt, put_output);
 			list_free(gl);
 			if(test(opt, PUT_TAGGED)) {
-				putfiles(gvLocalTagList, opt, put_output);
+				putpaths(gvLocalTagList, opt, put_output);
 				list_clear(gvLocalTagList);
 			}
 			free(put_output);
@@ -755,13 +793,14 @@ void cmd_put(int argc, char **argv)
 		exit(0);
 	}
 
-	putfiles(gl, opt, put_output);
+	putpaths(gl, opt, put_output);
 	list_free(gl);
 	if(test(opt, PUT_TAGGED)) {
-		putfiles(gvLocalTagList, opt, put_output);
+		putpaths(gvLocalTagList, opt, put_output);
 		list_clear(gvLocalTagList);
 	}
 	free(put_output);
+	ftp_mkpath_done();
 	gvInTransfer = false;
 
 	stats_display(gvStatsTransfer, stat_thresh);
@@ -381,6 +381,31 @@ int parse_rc(const char *file, bool warn)
 					 gvCacheTimeout);
 				gvCacheTimeout = 0;
 			}
+		} else if(strcasecmp(e, "cache_max_memory") == 0) {
+			long long size;
+			NEXTSTR;
+			if(strcasecmp(e, "unlimited") == 0)
+				gvCacheMaxMemory = 0;
+			else if((size = parse_human_size(e)) >= 0)
+				gvCacheMaxMemory = size;
+			else
+				errp(_("Invalid value for cache_max_memory: %s\n"), e);
+		} else if(strcasecmp(e, "persistent_cache_ttl") == 0) {
+			NEXTSTR;
+			gvPersistentCacheTTL = atoi(e);
+			if(gvPersistentCacheTTL < 0) {
+				errp(_("Invalid value for persistent_cache_ttl: %d\n"),
+					 gvPersistentCacheTTL);
+				gvPersistentCacheTTL = 0;
+			}
+		} else if(strcasecmp(e, "crawl_connections") == 0) {
+			NEXTSTR;
+			gvCrawlConnections = atoi(e);
+			if(gvCrawlConnections < 0) {
+				errp(_("Invalid value for crawl_connections: %d\n"),
+					 gvCrawlConnections);
+				gvCrawlConnections = 0;
+			}
 		} else if(strcasecmp(e, "connect_attempts") == 0) {
 			NEXTSTR;
 			gvConnectAttempts = (unsigned)atoi(e);
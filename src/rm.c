@@ -39,23 +39,33 @@ static void print_rm_syntax(void)
 static bool rm_quit = false;
 static bool rm_batch = false;
 
-static void remove_file(const rfile *f, unsigned opt)
+/* reports the outcome of each DELE sent by ftp_unlink_list() */
+static void remove_report(const char *path, bool removed, void *arg)
 {
-	ftp_set_tmp_verbosity(vbNone);
-	ftp_unlink(f->path);
+	unsigned opt = *(unsigned *)arg;
+
 	if(test(opt, RM_VERBOSE)) {
-		char* sp = shortpath(f->path, 40, ftp->homedir);
+		char* sp = shortpath(path, 40, ftp->homedir);
 		fprintf(stderr, "%s", sp);
 		free(sp);
-		if(ftp->code != ctComplete)
+		if(!removed)
 			fprintf(stderr, ": %s", ftp_getreply(false));
 		fprintf(stderr, "\n");
 	}
 }
 
-static void remove_files(const list *gl, unsigned opt)
+/* removes the files in GL, descending into directories if recursive;
+ * the files are collected and removed together, with the DELE commands
+ * pipelined, and a directory is only removed once all its contents are
+ * gone
+ *
+ * returns the number of files or directories not removed
+ */
+static int remove_files(const list *gl, unsigned opt)
 {
 	listitem *li;
+	list *files = list_new(0);
+	int failed = 0;
 
 	for(li=gl->first; li && !rm_quit; li=li->next) {
 		rfile *f = (rfile *)li->data;
@@ -73,8 +83,10 @@ static void remove_files(const list *gl, unsigned opt)
 			int a = ask(ASKYES|ASKNO|ASKCANCEL|ASKALL, ASKYES,
 						_("Remove remote file '%s'?"), sp);
 			free(sp);
-			if(a == ASKNO)
+			if(a == ASKNO) {
+				failed++;
 				continue;
+			}
 			if(a == ASKCANCEL) {
 				rm_quit = true;
 				break;
@@ -88,11 +100,12 @@ static void remove_files(const list *gl, unsigned opt)
 			if(test(opt, RM_RECURSIVE)) {
 				char *recurs_mask;
 				char *q_recurs_mask;
+				int r = 0;
 
 				if (asprintf(&recurs_mask, "%s/*", f->path) == -1)
         {
           fprintf(stderr, _("Failed to allocate memory.\n"));
-          return;
+          break;
         }
 
         list* rgl = rglob_create();
@@ -100,10 +113,24 @@ static void remove_files(const list *gl, unsigned opt)
 				rglob_glob(rgl, q_recurs_mask, false, true, 0);
 				free(q_recurs_mask);
 				if(list_numitem(rgl) > 0)
-					remove_files(rgl, opt);
+					r = remove_files(rgl, opt);
 				rglob_destroy(rgl);
 				free(recurs_mask);
-				ftp_rmdir(f->path);
+
+				/* the server would refuse to remove it anyway */
+				if(r != 0 || rm_quit || gvInterrupted) {
+					if(!rm_quit && !gvInterrupted) {
+						char* sp = shortpath(f->path, 40, ftp->homedir);
+						fprintf(stderr,
+								_("%s: directory not empty, not removed\n"), sp);
+						free(sp);
+					}
+					failed++;
+					continue;
+				}
+
+				if(ftp_rmdir(f->path) != 0)
+					failed++;
 				if(test(opt, RM_VERBOSE)) {
 					char* sp = shortpath(f->path, 40, ftp->homedir);
 					fprintf(stderr, "%s", sp);
@@ -117,11 +144,20 @@ static void remove_files(const list *gl, unsigned opt)
 				char* sp = shortpath(f->path, 40, ftp->homedir);
 				fprintf(stderr, _("%s  omitting directory\n"), sp);
 				free(sp);
+				failed++;
 			}
 			continue;
 		}
-		remove_file(f, opt);
+		list_additem(files, f->path);
 	}
+
+	if(list_numitem(files) > 0 && !gvInterrupted) {
+		int r = ftp_unlink_list(files, remove_report, &opt);
+		failed += (r == -1) ? list_numitem(files) : r;
+	} else
+		failed += list_numitem(files);
+	list_free(files);
+	return failed;
 }
 
 void cmd_rm(int argc, char **argv)
@@ -196,6 +232,14 @@ void cmd_rm(int argc, char **argv)
 	if(test(opt, RM_FORCE))
 		opt &= ~RM_INTERACTIVE;
 
+	/* list the whole tree at once, remove_files() then finds the
+	 * directories in the cache */
+	if(test(opt, RM_RECURSIVE)) {
+		ftp_crawl(gl, gvCrawlConnections, 0);
+		if(test(opt, RM_TAGGED) && ftp->taglist)
+			ftp_crawl(ftp->taglist, gvCrawlConnections, 0);
+	}
+
 	remove_files(gl, opt);
 	if(test(opt, RM_TAGGED)) {
 		remove_files(ftp->taglist, opt);
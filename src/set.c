@@ -15,6 +15,7 @@
 #include "gvars.h"
 #include "strq.h"
 #include "set.h"
+#include "utils.h"
 
 static void set_autologin(void *val)
 {
@@ -110,6 +111,59 @@ static void set_anonpass(void *val)
 	printf(_("anonymous password is '%s'\n"), gvAnonPasswd);
 }
 
+/* changes the size of the data transfer buffers, "auto" or a size in
+ * bytes with an optional k or M suffix
+ */
+static void set_transfer_buffer(void *val)
+{
+	if(val) {
+		const char *str = (const char *)val;
+
+		if(strcasecmp(str, "auto") == 0)
+			gvTransferBuffer = 0;
+		else {
+			long long size = parse_human_size(str);
+
+			if(size < 512 || size > FTP_MAXBUFSIZ) {
+				printf(_("Invalid transfer buffer size '%s'? Use 'auto' or"
+						 " a size between 512 and %dk\n"),
+					   str, FTP_MAXBUFSIZ / 1024);
+				return;
+			}
+			gvTransferBuffer = size;
+		}
+	}
+	if(gvTransferBuffer == 0)
+		puts(_("transfer buffer is 'auto'"));
+	else
+		printf(_("transfer buffer is %d bytes\n"), gvTransferBuffer);
+}
+
+/* changes the memory budget of the directory cache, "unlimited" or a
+ * size in bytes with an optional k, M or G suffix
+ */
+static void set_cache_max_memory(void *val)
+{
+	if(val) {
+		const char *str = (const char *)val;
+		long long size;
+
+		if(strcasecmp(str, "unlimited") == 0)
+			size = 0;
+		else if((size = parse_human_size(str)) < 0) {
+			printf(_("Invalid cache size '%s'? Use 'unlimited' or a size"
+					 " like 64M\n"), str);
+			return;
+		}
+		gvCacheMaxMemory = size;
+		ftp_cache_flush();
+	}
+	if(gvCacheMaxMemory == 0)
+		puts(_("cache max memory is 'unlimited'"));
+	else
+		printf(_("cache max memory is %sB\n"), human_size(gvCacheMaxMemory));
+}
+
 struct _setvar setvariables[] = {
 	{"autologin", ARG_BOOL, set_autologin},
 	{"debug", ARG_BOOL, set_debug},
@@ -117,6 +171,8 @@ struct _setvar setvariables[] = {
 	{"passive_mode", ARG_BOOL, set_pasvmode},
 	{"type", ARG_STR, set_type},
 	{"anonpass", ARG_STR, set_anonpass},
+	{"transfer_buffer", ARG_STR, set_transfer_buffer},
+	{"cache_max_memory", ARG_STR, set_cache_max_memory},
 	{NULL, 0, NULL}
 };
 
@@ -18,6 +18,7 @@
 #include "args.h"
 #include "transfer.h"
 #include "utils.h"
+#include "jobs.h"
 
 static FILE *logfp = 0;
 static FILE *mailfp = 0;
@@ -247,7 +248,7 @@ void transfer(transfer_info *ti)
 	unsigned int secs, eta;
 	float bps;
 
-	if(gvSighupReceived)
+	if(gvSighupReceived || job_report(ti))
 		return;
 
 	while(lastlen--)
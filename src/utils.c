@@ -93,6 +93,29 @@ char *human_size(long long int size)
 	return buf;
 }
 
+/* parses a size in bytes with an optional k, M or G suffix
+ * returns the size, or -1 if STR isn't a valid size
+ */
+long long int parse_human_size(const char *str)
+{
+	char *e;
+	long long int size = strtoll(str, &e, 10);
+
+	if(e == str || size < 0)
+		return -1;
+	if(*e == 'k' || *e == 'K') {
+		size *= 1024;
+		e++;
+	} else if(*e == 'm' || *e == 'M') {
+		size *= 1024 * 1024;
+		e++;
+	} else if(*e == 'g' || *e == 'G') {
+		size *= 1024 * 1024 * 1024;
+		e++;
+	}
+	return *e == 0 ? size : -1;
+}
+
 char *human_time(unsigned int secs)
 {
 	static char buf[17];
@@ -21,6 +21,7 @@ void listify_string(const char *str, list *lp);
 char *stringify_list(list *lp);
 char *make_unique_filename(const char *path);
 char *human_size(long long int size);
+long long int parse_human_size(const char *str);
 char *human_time(unsigned int secs);
 void print_xterm_title(void);
 void reset_xterm_title(void);